@@ -112,6 +112,18 @@ CFG_CORE_UNMAP_CORE_AT_EL0 ?= y
 # save/restore PMCR during world switch.
 CFG_SM_NO_CYCLE_COUNTING ?= y
 
+# Use ticket locks instead of test-and-set locks for the core spinlocks.
+# Ticket locks hand the lock over in FIFO order, so no core can be starved
+# when a lock is contended, at the cost of slightly more work when taking
+# an uncontended lock.
+CFG_CORE_TICKET_SPINLOCK ?= n
+
+# Collect per-core latency histograms, based on the physical counter, of
+# each OPTEE_MSG command served by a yielding call, of each fast call and
+# of each RPC command served by normal world. Exported by the stats pseudo
+# TA.
+CFG_CORE_CALL_STATS ?= n
+
 
 # CFG_CORE_ASYNC_NOTIF_GIC_INTID is defined by the platform to some free
 # interrupt. Setting it to a non-zero number enables support for using an
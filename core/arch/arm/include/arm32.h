@@ -213,6 +213,11 @@ static inline __noprof void wfe(void)
 	asm volatile ("wfe");
 }
 
+static inline __noprof void yield(void)
+{
+	asm volatile ("yield");
+}
+
 static inline __noprof uint32_t read_cpsr(void)
 {
 	uint32_t cpsr;
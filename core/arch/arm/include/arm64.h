@@ -230,6 +230,11 @@ static inline __noprof void wfe(void)
 	asm volatile ("wfe");
 }
 
+static inline __noprof void yield(void)
+{
+	asm volatile ("yield");
+}
+
 static inline __noprof void wfi(void)
 {
 	asm volatile ("wfi");
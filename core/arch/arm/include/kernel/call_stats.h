@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, The OP-TEE Project Contributors
+ */
+
+#ifndef __KERNEL_CALL_STATS_H
+#define __KERNEL_CALL_STATS_H
+
+#include <arm.h>
+#include <compiler.h>
+#include <stdint.h>
+#include <types_ext.h>
+
+/*
+ * Number of log2 buckets in a latency histogram. Bucket n counts calls
+ * which took [2^(n - 1), 2^n) counter ticks, bucket 0 counts calls which
+ * took 0 ticks and the last bucket also counts everything longer.
+ */
+#define CALL_STATS_NUM_BUCKETS	24
+
+/*
+ * Number of tracked commands per class, commands beyond the last slot
+ * are accounted in the last slot.
+ */
+#define CALL_STATS_NUM_MSG_CMDS	16
+#define CALL_STATS_NUM_RPC_CMDS	24
+#define CALL_STATS_NUM_FAST_CMDS	64
+
+enum call_stats_class {
+	CALL_STATS_MSG,	/* OPTEE_MSG_CMD_* served by a yielding call */
+	CALL_STATS_RPC,	/* OPTEE_RPC_CMD_* served by normal world */
+	CALL_STATS_FAST, /* OPTEE_SMC_FUNCID_* served by a fast call */
+};
+
+/*
+ * struct call_stats_hist - latency histogram of a command on one core
+ * @count:	number of completed calls
+ * @total:	sum of the latencies in counter ticks
+ * @max:	longest latency in counter ticks
+ * @buckets:	log2 latency histogram, see CALL_STATS_NUM_BUCKETS
+ */
+struct call_stats_hist {
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+	uint32_t buckets[CALL_STATS_NUM_BUCKETS];
+};
+
+#ifdef CFG_CORE_CALL_STATS
+static inline uint64_t call_stats_start(void)
+{
+	return barrier_read_counter_timer();
+}
+
+/*
+ * Account a call of @cmd started at @start, the call is attributed to
+ * the core it completes on.
+ */
+void call_stats_done(enum call_stats_class class, uint32_t cmd,
+		     uint64_t start);
+
+/* Returns the number of histograms per core for @class */
+size_t call_stats_num_cmds(enum call_stats_class class);
+
+/*
+ * Copies the call_stats_num_cmds(@class) histograms of core @core_pos
+ * into @hist. The counters are read without synchronizing with the
+ * owning core so a histogram being updated may be slightly inconsistent.
+ */
+void call_stats_get(enum call_stats_class class, size_t core_pos,
+		    struct call_stats_hist *hist);
+
+void call_stats_reset(void);
+#else
+static inline uint64_t call_stats_start(void)
+{
+	return 0;
+}
+
+static inline void call_stats_done(enum call_stats_class class __unused,
+				   uint32_t cmd __unused,
+				   uint64_t start __unused)
+{
+}
+
+static inline size_t call_stats_num_cmds(enum call_stats_class class __unused)
+{
+	return 0;
+}
+
+static inline void call_stats_get(enum call_stats_class class __unused,
+				  size_t core_pos __unused,
+				  struct call_stats_hist *hist __unused)
+{
+}
+
+static inline void call_stats_reset(void)
+{
+}
+#endif
+
+#endif /*__KERNEL_CALL_STATS_H*/
@@ -10,6 +10,9 @@
 #define SPINLOCK_LOCK       1
 #define SPINLOCK_UNLOCK     0
 
+/* Added to a ticket lock to take the next ticket */
+#define SPINLOCK_TICKET_INC	0x10000
+
 #ifndef __ASSEMBLER__
 #include <assert.h>
 #include <compiler.h>
@@ -24,10 +27,19 @@ static inline void __nostackcheck assert_have_no_spinlock(void)
 {
 	assert(!have_spinlock());
 }
+
+/*
+ * Records that @lock was found held when trying to take it from @func at
+ * @line. spinlock_dump_contention() prints the recorded locks with the
+ * number of times each was found held.
+ */
+void spinlock_contended(unsigned int *lock, const char *func, int line);
+void spinlock_dump_contention(void);
 #else
 static inline void spinlock_count_incr(void) { }
 static inline void spinlock_count_decr(void) { }
 static inline void __nostackcheck assert_have_no_spinlock(void) { }
+static inline void spinlock_dump_contention(void) { }
 #endif
 
 void __cpu_spin_lock(unsigned int *lock);
@@ -35,6 +47,35 @@ void __cpu_spin_unlock(unsigned int *lock);
 /* returns 0 on locking success, non zero on failure */
 unsigned int __cpu_spin_trylock(unsigned int *lock);
 
+#ifdef CFG_CORE_TICKET_SPINLOCK
+/* Takes the next ticket of @lock and returns it */
+unsigned int __cpu_spin_take_ticket(unsigned int *lock);
+/* Returns the ticket currently served by @lock, with acquire semantics */
+unsigned int __cpu_spin_get_serving(unsigned int *lock);
+
+static inline unsigned int __cpu_spin_lock_start(unsigned int *lock)
+{
+	return __cpu_spin_take_ticket(lock);
+}
+
+static inline bool __cpu_spin_lock_poll(unsigned int *lock,
+					unsigned int ticket)
+{
+	return __cpu_spin_get_serving(lock) == ticket;
+}
+#else
+static inline unsigned int __cpu_spin_lock_start(unsigned int *lock __unused)
+{
+	return 0;
+}
+
+static inline bool __cpu_spin_lock_poll(unsigned int *lock,
+					unsigned int ticket __unused)
+{
+	return !__cpu_spin_trylock(lock);
+}
+#endif
+
 static inline void cpu_spin_lock_no_dldetect(unsigned int *lock)
 {
 	assert(thread_foreign_intr_disabled());
@@ -51,10 +92,14 @@ static inline void cpu_spin_lock_dldetect(const char *func, const int line,
 {
 	unsigned int retries = 0;
 	unsigned int reminder = 0;
+	unsigned int ticket = 0;
 
 	assert(thread_foreign_intr_disabled());
 
-	while (__cpu_spin_trylock(lock)) {
+	ticket = __cpu_spin_lock_start(lock);
+	while (!__cpu_spin_lock_poll(lock, ticket)) {
+		if (!retries && !reminder)
+			spinlock_contended(lock, func, line);
 		retries++;
 		if (!retries) {
 			/* wrapped, time to report */
@@ -330,9 +330,30 @@ short int thread_get_id(void);
  */
 short int thread_get_id_may_fail(void);
 
+/*
+ * Returns true if thread @thread_id is currently executing on a core, that
+ * is, it isn't suspended or free. The result is only a hint since the
+ * state of the thread may change at any time.
+ */
+bool thread_is_active(short int thread_id);
+
 /* Returns Thread Specific Data (TSD) pointer. */
 struct thread_specific_data *thread_get_tsd(void);
 
+/*
+ * struct thread_alloc_stats - thread allocation statistics
+ * @warm:	standard calls started on a thread which last ran on the
+ *		same core
+ * @cold:	standard calls started on a thread which last ran on
+ *		another core, or never ran
+ */
+struct thread_alloc_stats {
+	uint32_t warm;
+	uint32_t cold;
+};
+
+void thread_get_alloc_stats(struct thread_alloc_stats *stats, bool reset);
+
 /*
  * Sets foreign interrupts status for current thread, must only be called
  * from an active thread context.
@@ -770,13 +791,31 @@ enum thread_shm_cache_user {
 
 /*
  * Returns a pointer to the cached RPC memory. Each thread and @user tuple
- * has a unique cache. The pointer is guaranteed to point to a large enough
- * area or to be NULL.
+ * has a unique cache holding a few buffers of different sizes. The
+ * pointer is guaranteed to point to a large enough area or to be NULL and
+ * is valid until the next call with the same @user.
  */
 void *thread_rpc_shm_cache_alloc(enum thread_shm_cache_user user,
 				 enum thread_shm_type shm_type,
 				 size_t size, struct mobj **mobj);
 
+/*
+ * struct thread_shm_cache_stats - RPC shared memory cache statistics
+ * @hits:	allocations served by an already cached buffer
+ * @misses:	allocations which needed a buffer from normal world
+ * @evictions:	buffers freed to make room for a buffer of another size
+ * @trims:	buffers freed because they weren't used for a while
+ */
+struct thread_shm_cache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	uint32_t trims;
+};
+
+void thread_rpc_shm_cache_get_stats(struct thread_shm_cache_stats *stats,
+				    bool reset);
+
 #endif /*__ASSEMBLER__*/
 
 #endif /*KERNEL_THREAD_H*/
@@ -510,6 +510,20 @@ void core_mmu_set_entry_primitive(void *table, size_t level, size_t idx,
 
 void core_mmu_get_user_pgdir(struct core_mmu_table_info *pgd_info);
 
+/*
+ * core_mmu_clear_user_blocks() - Clear block mappings in the user directory
+ * @va:		Start of the unmapped user VA range
+ * @len:	Length of the range
+ *
+ * Clears every block (LPAE) or section (v7) descriptor intersecting the
+ * range in the directory table of the currently active user mapping, also
+ * the parts of the blocks outside the range. Returns true if a descriptor
+ * was cleared, in which case the caller has to rebuild the user mapping
+ * with vm_set_ctx() once the VM regions are updated. The caller is
+ * responsible for flushing the TLB.
+ */
+bool core_mmu_clear_user_blocks(vaddr_t va, size_t len);
+
 /*
  * core_mmu_set_entry() - Set entry in translation table
  * @tbl_info:	Translation table properties
@@ -27,6 +27,8 @@ struct pgt {
 #if defined(CFG_PAGED_USER_TA)
 	struct ts_ctx *ctx;
 	size_t num_used_entries;
+	LIST_ENTRY(pgt) hash_link;
+	TAILQ_ENTRY(pgt) lru_link;
 #endif
 #if defined(CFG_WITH_PAGER)
 #if !defined(CFG_WITH_LPAE)
@@ -57,8 +59,15 @@ static inline bool pgt_check_avail(size_t num_tbls)
 	return num_tbls <= PGT_CACHE_SIZE;
 }
 
+/*
+ * Allocates translation tables covering [@begin, @last] in @pgt_cache. If
+ * @skip isn't NULL no table is allocated for the directory entries at
+ * the VA for which @skip(@skip_arg, va) returns true, these are queried in
+ * increasing order.
+ */
 void pgt_alloc(struct pgt_cache *pgt_cache, struct ts_ctx *owning_ctx,
-	       vaddr_t begin, vaddr_t last);
+	       vaddr_t begin, vaddr_t last,
+	       bool (*skip)(void *skip_arg, vaddr_t va), void *skip_arg);
 void pgt_free(struct pgt_cache *pgt_cache, bool save_ctx);
 
 void pgt_clear_ctx_range(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
@@ -293,6 +293,10 @@
 #define OPTEE_SMC_SEC_CAP_ASYNC_NOTIF		BIT(5)
 /* Secure world is built with OCALL support */
 #define OPTEE_SMC_SEC_CAP_OCALL			BIT(31)
+/* Secure world supports OPTEE_MSG_CMD_INVOKE_BATCH */
+#define OPTEE_SMC_SEC_CAP_INVOKE_BATCH		BIT(30)
+/* Secure world supports OPTEE_MSG_CMD_INVOKE_ASYNC */
+#define OPTEE_SMC_SEC_CAP_INVOKE_ASYNC		BIT(29)
 
 #define OPTEE_SMC_FUNCID_EXCHANGE_CAPABILITIES	U(9)
 #define OPTEE_SMC_EXCHANGE_CAPABILITIES \
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, The OP-TEE Project Contributors
+ */
+
+#include <kernel/call_stats.h>
+#include <kernel/misc.h>
+#include <kernel/thread.h>
+#include <string.h>
+#include <util.h>
+
+/*
+ * Each core only updates its own histograms, with foreign interrupts
+ * masked, so no locking or atomic operations are needed on the hot path.
+ */
+struct call_stats_core {
+	struct call_stats_hist msg[CALL_STATS_NUM_MSG_CMDS];
+	struct call_stats_hist rpc[CALL_STATS_NUM_RPC_CMDS];
+	struct call_stats_hist fast[CALL_STATS_NUM_FAST_CMDS];
+};
+
+static struct call_stats_core call_stats[CFG_TEE_CORE_NB_CORE] __nex_bss;
+
+static struct call_stats_hist *get_hist(struct call_stats_core *cs,
+					enum call_stats_class class)
+{
+	if (class == CALL_STATS_MSG)
+		return cs->msg;
+	if (class == CALL_STATS_FAST)
+		return cs->fast;
+	return cs->rpc;
+}
+
+size_t call_stats_num_cmds(enum call_stats_class class)
+{
+	if (class == CALL_STATS_MSG)
+		return CALL_STATS_NUM_MSG_CMDS;
+	if (class == CALL_STATS_FAST)
+		return CALL_STATS_NUM_FAST_CMDS;
+	return CALL_STATS_NUM_RPC_CMDS;
+}
+
+static unsigned int get_bucket(uint64_t ticks)
+{
+	unsigned int n = 0;
+
+	if (ticks)
+		n = 64 - __builtin_clzll(ticks);
+
+	return MIN(n, (unsigned int)CALL_STATS_NUM_BUCKETS - 1);
+}
+
+void call_stats_done(enum call_stats_class class, uint32_t cmd,
+		     uint64_t start)
+{
+	uint64_t ticks = barrier_read_counter_timer() - start;
+	size_t n = call_stats_num_cmds(class);
+	uint32_t exceptions = 0;
+	struct call_stats_hist *h = NULL;
+
+	exceptions = thread_mask_exceptions(THREAD_EXCP_FOREIGN_INTR);
+	h = get_hist(call_stats + get_core_pos(), class) + MIN(cmd, n - 1);
+	h->count++;
+	h->total += ticks;
+	if (ticks > h->max)
+		h->max = ticks;
+	h->buckets[get_bucket(ticks)]++;
+	thread_unmask_exceptions(exceptions);
+}
+
+void call_stats_get(enum call_stats_class class, size_t core_pos,
+		    struct call_stats_hist *hist)
+{
+	if (core_pos >= CFG_TEE_CORE_NB_CORE)
+		return;
+
+	memcpy(hist, get_hist(call_stats + core_pos, class),
+	       call_stats_num_cmds(class) * sizeof(*hist));
+}
+
+void call_stats_reset(void)
+{
+	/*
+	 * Counts of calls completing on other cores while clearing may be
+	 * lost, which is acceptable for statistics.
+	 */
+	memset(call_stats, 0, sizeof(call_stats));
+}
@@ -30,7 +30,7 @@ static TEE_Result alloc_and_map_ldelf_fobj(struct user_mode_ctx *uctx,
 					   vaddr_t *va)
 {
 	size_t num_pgs = ROUNDUP(sz, SMALL_PAGE_SIZE) / SMALL_PAGE_SIZE;
-	struct fobj *fobj = fobj_ta_mem_alloc(num_pgs);
+	struct fobj *fobj = ldelf_ta_mem_alloc(num_pgs);
 	struct mobj *mobj = mobj_with_fobj_alloc(fobj, NULL);
 	TEE_Result res = TEE_SUCCESS;
 
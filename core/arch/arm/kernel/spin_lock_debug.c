@@ -4,10 +4,29 @@
  */
 
 #include <assert.h>
+#include <atomic.h>
 #include <compiler.h>
 #include <kernel/spinlock.h>
+#include <trace.h>
+#include <util.h>
 #include "thread_private.h"
 
+#define SPINLOCK_STATS_COUNT	32
+
+struct spinlock_stat {
+	vaddr_t lock;
+	const char *func;
+	int line;
+	uint32_t count;
+};
+
+/*
+ * Open addressed table of contended locks, entries are claimed with a
+ * compare and swap so it can be updated while holding any spinlock.
+ */
+static struct spinlock_stat spinlock_stats[SPINLOCK_STATS_COUNT];
+static uint32_t spinlock_stats_dropped;
+
 void spinlock_count_incr(void)
 {
 	struct thread_core_local *l = thread_get_core_local();
@@ -41,3 +60,50 @@ bool __nostackcheck have_spinlock(void)
 
 	return !!l->locked_count;
 }
+
+void spinlock_contended(unsigned int *lock, const char *func, int line)
+{
+	vaddr_t va = (vaddr_t)lock;
+	size_t idx = (va >> 2) % SPINLOCK_STATS_COUNT;
+	struct spinlock_stat *st = NULL;
+	vaddr_t old = 0;
+	size_t n = 0;
+
+	for (n = 0; n < SPINLOCK_STATS_COUNT; n++) {
+		st = spinlock_stats + (idx + n) % SPINLOCK_STATS_COUNT;
+		old = __compiler_atomic_load(&st->lock);
+		if (!old) {
+			if (__compiler_compare_and_swap(&st->lock, &old, va)) {
+				st->func = func;
+				st->line = line;
+				atomic_inc32(&st->count);
+				return;
+			}
+			/* Someone else claimed the entry, old is updated */
+		}
+		if (old == va) {
+			atomic_inc32(&st->count);
+			return;
+		}
+	}
+
+	atomic_inc32(&spinlock_stats_dropped);
+}
+
+void spinlock_dump_contention(void)
+{
+	struct spinlock_stat *st = NULL;
+	size_t n = 0;
+
+	for (n = 0; n < ARRAY_SIZE(spinlock_stats); n++) {
+		st = spinlock_stats + n;
+		if (!__compiler_atomic_load(&st->lock))
+			continue;
+		IMSG("spinlock %#"PRIxVA" contended %"PRIu32" times, first at %s:%d",
+		     st->lock, atomic_load_u32(&st->count),
+		     st->func ? st->func : "?", st->line);
+	}
+	if (spinlock_stats_dropped)
+		IMSG("%"PRIu32" contentions on untracked spinlocks",
+		     atomic_load_u32(&spinlock_stats_dropped));
+}
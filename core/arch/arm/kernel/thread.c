@@ -9,6 +9,7 @@
 
 #include <arm.h>
 #include <assert.h>
+#include <atomic.h>
 #include <config.h>
 #include <io.h>
 #include <keep.h>
@@ -174,6 +175,8 @@ static uint8_t thread_user_kdata_page[
 #endif
 
 static unsigned int thread_global_lock __nex_bss = SPINLOCK_UNLOCK;
+/* Protected by thread_global_lock */
+static struct thread_alloc_stats thread_alloc_stats __nex_bss;
 
 static void init_canaries(void)
 {
@@ -534,6 +537,47 @@ void __nostackcheck thread_clr_boot_thread(void)
 	l->curr_thread = THREAD_ID_INVALID;
 }
 
+/*
+ * Returns a free thread, preferably one which last ran on core @pos since
+ * its stack and context are more likely to still be in the caches of
+ * this core. Returns CFG_NUM_THREADS if no thread is free.
+ * Called with thread_global_lock held.
+ */
+static size_t find_free_thread(size_t pos)
+{
+	size_t first_free = CFG_NUM_THREADS;
+	size_t n = 0;
+
+	for (n = 0; n < CFG_NUM_THREADS; n++) {
+		if (threads[n].state != THREAD_STATE_FREE)
+			continue;
+		if (threads[n].last_core_pos == pos) {
+			thread_alloc_stats.warm++;
+			return n;
+		}
+		if (first_free == CFG_NUM_THREADS)
+			first_free = n;
+	}
+
+	if (first_free != CFG_NUM_THREADS)
+		thread_alloc_stats.cold++;
+
+	return first_free;
+}
+
+void thread_get_alloc_stats(struct thread_alloc_stats *stats, bool reset)
+{
+	uint32_t exceptions = thread_mask_exceptions(THREAD_EXCP_ALL);
+
+	thread_lock_global();
+	*stats = thread_alloc_stats;
+	if (reset)
+		thread_alloc_stats = (struct thread_alloc_stats){ };
+	thread_unlock_global();
+
+	thread_unmask_exceptions(exceptions);
+}
+
 static void __thread_alloc_and_run(uint32_t a0, uint32_t a1, uint32_t a2,
 				   uint32_t a3, uint32_t a4, uint32_t a5,
 				   uint32_t a6, uint32_t a7,
@@ -547,12 +591,10 @@ static void __thread_alloc_and_run(uint32_t a0, uint32_t a1, uint32_t a2,
 
 	thread_lock_global();
 
-	for (n = 0; n < CFG_NUM_THREADS; n++) {
-		if (threads[n].state == THREAD_STATE_FREE) {
-			threads[n].state = THREAD_STATE_ACTIVE;
-			found_thread = true;
-			break;
-		}
+	n = find_free_thread(get_core_pos());
+	if (n < CFG_NUM_THREADS) {
+		threads[n].state = THREAD_STATE_ACTIVE;
+		found_thread = true;
 	}
 
 	thread_unlock_global();
@@ -849,6 +891,7 @@ void thread_state_free(void)
 	assert(threads[ct].state == THREAD_STATE_ACTIVE);
 	threads[ct].state = THREAD_STATE_FREE;
 	threads[ct].flags = 0;
+	threads[ct].last_core_pos = get_core_pos();
 	l->curr_thread = THREAD_ID_INVALID;
 
 	if (IS_ENABLED(CFG_VIRTUALIZATION))
@@ -994,6 +1037,19 @@ short int thread_get_id(void)
 	return ct;
 }
 
+bool thread_is_active(short int thread_id)
+{
+	if (thread_id < 0 || thread_id >= CFG_NUM_THREADS)
+		return false;
+
+	/*
+	 * Read without holding thread_global_lock, the result is only a
+	 * hint which may be outdated as soon as it's returned.
+	 */
+	return __compiler_atomic_load(&threads[thread_id].state) ==
+	       THREAD_STATE_ACTIVE;
+}
+
 #ifdef CFG_WITH_PAGER
 static void init_thread_stacks(void)
 {
@@ -1083,6 +1139,7 @@ void thread_init_threads(void)
 	for (n = 0; n < CFG_NUM_THREADS; n++) {
 		TAILQ_INIT(&threads[n].tsd.sess_stack);
 		SLIST_INIT(&threads[n].tsd.pgt_cache);
+		threads[n].last_core_pos = CFG_TEE_CORE_NB_CORE;
 	}
 }
 
@@ -1627,22 +1684,108 @@ static void clear_shm_cache_entry(struct thread_shm_cache_entry *ce)
 	ce->size = 0;
 }
 
+/* Max number of buffers cached per thread and user */
+#define THREAD_SHM_CACHE_MAX_ENTRIES	4
+/* Buffers unused by this many allocations of a thread are released */
+#define THREAD_SHM_CACHE_IDLE_ALLOCS	32
+
+static struct thread_shm_cache_stats shm_cache_stats;
+
+/*
+ * Normal world allocates payload memory as complete pages, buffers are
+ * cached in sizes of a power of two number of pages to make it likely
+ * that a cached buffer fits the next request.
+ */
+static size_t shm_cache_bucket_size(size_t size)
+{
+	size_t sz = SMALL_PAGE_SIZE;
+
+	while (sz < size) {
+		if (MUL_OVERFLOW(sz, 2, &sz))
+			return 0;
+	}
+
+	return sz;
+}
+
+static void free_shm_cache_entry(struct thread_shm_cache *cache,
+				 struct thread_shm_cache_entry *ce)
+{
+	SLIST_REMOVE(&cache->list, ce, thread_shm_cache_entry, link);
+	clear_shm_cache_entry(ce);
+	free(ce);
+}
+
+/*
+ * Releases the buffers of @user which haven't been used by the last
+ * THREAD_SHM_CACHE_IDLE_ALLOCS allocations of this thread. Buffers of
+ * other users are left alone since they must stay valid until the next
+ * allocation of their own user.
+ */
+static void trim_shm_cache(struct thread_shm_cache *cache,
+			   enum thread_shm_cache_user user)
+{
+	struct thread_shm_cache_entry *next = NULL;
+	struct thread_shm_cache_entry *ce = NULL;
+
+	SLIST_FOREACH_SAFE(ce, &cache->list, link, next) {
+		if (ce->user != user)
+			continue;
+		if (cache->seq - ce->last_used > THREAD_SHM_CACHE_IDLE_ALLOCS) {
+			free_shm_cache_entry(cache, ce);
+			atomic_inc32(&shm_cache_stats.trims);
+		}
+	}
+}
+
 static struct thread_shm_cache_entry *
-get_shm_cache_entry(enum thread_shm_cache_user user)
+get_shm_cache_entry(enum thread_shm_cache_user user,
+		    enum thread_shm_type shm_type, size_t size, bool *hit)
 {
 	struct thread_shm_cache *cache = &threads[thread_get_id()].shm_cache;
+	struct thread_shm_cache_entry *best = NULL;
+	struct thread_shm_cache_entry *lru = NULL;
 	struct thread_shm_cache_entry *ce = NULL;
+	size_t count = 0;
 
-	SLIST_FOREACH(ce, cache, link)
-		if (ce->user == user)
-			return ce;
+	cache->seq++;
+	trim_shm_cache(cache, user);
+
+	/*
+	 * Pick the smallest cached buffer which is large enough, keeping
+	 * track of the least recently used buffer of this user in case a
+	 * buffer has to be evicted.
+	 */
+	SLIST_FOREACH(ce, &cache->list, link) {
+		if (ce->user != user)
+			continue;
+		count++;
+		if (!lru || cache->seq - ce->last_used >
+			    cache->seq - lru->last_used)
+			lru = ce;
+		if (ce->mobj && ce->type == shm_type && ce->size >= size &&
+		    (!best || ce->size < best->size))
+			best = ce;
+	}
 
-	ce = calloc(1, sizeof(*ce));
-	if (ce) {
+	*hit = best;
+	if (best) {
+		ce = best;
+	} else if (count >= THREAD_SHM_CACHE_MAX_ENTRIES) {
+		ce = lru;
+		if (ce->mobj)
+			atomic_inc32(&shm_cache_stats.evictions);
+		clear_shm_cache_entry(ce);
+	} else {
+		ce = calloc(1, sizeof(*ce));
+		if (!ce)
+			return NULL;
 		ce->user = user;
-		SLIST_INSERT_HEAD(cache, ce, link);
+		SLIST_INSERT_HEAD(&cache->list, ce, link);
 	}
 
+	ce->last_used = cache->seq;
+
 	return ce;
 }
 
@@ -1654,22 +1797,21 @@ void *thread_rpc_shm_cache_alloc(enum thread_shm_cache_user user,
 	size_t sz = size;
 	paddr_t p = 0;
 	void *va = NULL;
+	bool hit = false;
 
 	if (!size)
 		return NULL;
 
-	ce = get_shm_cache_entry(user);
-	if (!ce)
+	sz = shm_cache_bucket_size(size);
+	if (!sz)
 		return NULL;
 
-	/*
-	 * Always allocate in page chunks as normal world allocates payload
-	 * memory as complete pages.
-	 */
-	sz = ROUNDUP(size, SMALL_PAGE_SIZE);
+	ce = get_shm_cache_entry(user, shm_type, sz, &hit);
+	if (!ce)
+		return NULL;
 
-	if (ce->type != shm_type || sz > ce->size) {
-		clear_shm_cache_entry(ce);
+	if (!hit) {
+		atomic_inc32(&shm_cache_stats.misses);
 
 		ce->mobj = alloc_shm(shm_type, sz);
 		if (!ce->mobj)
@@ -1688,6 +1830,8 @@ void *thread_rpc_shm_cache_alloc(enum thread_shm_cache_user user,
 		ce->size = sz;
 		ce->type = shm_type;
 	} else {
+		atomic_inc32(&shm_cache_stats.hits);
+
 		va = mobj_get_va(ce->mobj, 0, sz);
 		if (!va)
 			goto err;
@@ -1703,14 +1847,31 @@ err:
 void thread_rpc_shm_cache_clear(struct thread_shm_cache *cache)
 {
 	while (true) {
-		struct thread_shm_cache_entry *ce = SLIST_FIRST(cache);
+		struct thread_shm_cache_entry *ce = SLIST_FIRST(&cache->list);
 
 		if (!ce)
 			break;
-		SLIST_REMOVE_HEAD(cache, link);
+		SLIST_REMOVE_HEAD(&cache->list, link);
 		clear_shm_cache_entry(ce);
 		free(ce);
 	}
+	cache->seq = 0;
+}
+
+void thread_rpc_shm_cache_get_stats(struct thread_shm_cache_stats *stats,
+				    bool reset)
+{
+	stats->hits = atomic_load_u32(&shm_cache_stats.hits);
+	stats->misses = atomic_load_u32(&shm_cache_stats.misses);
+	stats->evictions = atomic_load_u32(&shm_cache_stats.evictions);
+	stats->trims = atomic_load_u32(&shm_cache_stats.trims);
+
+	if (reset) {
+		atomic_store_u32(&shm_cache_stats.hits, 0);
+		atomic_store_u32(&shm_cache_stats.misses, 0);
+		atomic_store_u32(&shm_cache_stats.evictions, 0);
+		atomic_store_u32(&shm_cache_stats.trims, 0);
+	}
 }
 
 #ifdef CFG_WITH_ARM_TRUSTED_FW
@@ -7,6 +7,7 @@
 #include <compiler.h>
 #include <config.h>
 #include <io.h>
+#include <kernel/call_stats.h>
 #include <kernel/misc.h>
 #include <kernel/msg_param.h>
 #include <kernel/thread.h>
@@ -29,6 +30,9 @@ static unsigned int thread_rpc_pnum;
 
 void thread_handle_fast_smc(struct thread_smc_args *args)
 {
+	uint32_t funcid = OPTEE_SMC_FUNC_NUM(args->a0);
+	uint64_t start = call_stats_start();
+
 	thread_check_canaries();
 
 	if (IS_ENABLED(CFG_VIRTUALIZATION) &&
@@ -42,6 +46,7 @@ void thread_handle_fast_smc(struct thread_smc_args *args)
 	if (IS_ENABLED(CFG_VIRTUALIZATION))
 		virt_unset_guest();
 
+	call_stats_done(CALL_STATS_FAST, funcid, start);
 out:
 	/* Fast handlers must not unmask any exceptions */
 	assert(thread_get_exceptions() == THREAD_EXCP_ALL);
@@ -160,6 +165,8 @@ static uint32_t std_smc_entry(uint32_t a0, uint32_t a1, uint32_t a2,
 	struct optee_msg_arg *arg = NULL;
 	uint32_t num_params = 0;
 	struct mobj *mobj = NULL;
+	uint64_t start = 0;
+	uint32_t cmd = 0;
 	uint32_t rv = 0;
 
 	if (a0 != OPTEE_SMC_CALL_WITH_ARG) {
@@ -187,7 +194,10 @@ static uint32_t std_smc_entry(uint32_t a0, uint32_t a1, uint32_t a2,
 
 	arg = mobj_get_va(mobj, 0, OPTEE_MSG_GET_ARG_SIZE(num_params));
 	assert(arg && mobj_is_nonsec(mobj));
+	cmd = READ_ONCE(arg->cmd);
+	start = call_stats_start();
 	rv = tee_entry_std(arg, num_params);
+	call_stats_done(CALL_STATS_MSG, cmd, start);
 	mobj_put(mobj);
 
 	return rv;
@@ -482,6 +492,15 @@ static uint32_t get_rpc_arg_res(struct optee_msg_arg *arg, size_t num_params,
 	return arg->ret;
 }
 
+static void thread_rpc_timed(uint32_t cmd,
+			     uint32_t rpc_args[THREAD_RPC_NUM_ARGS])
+{
+	uint64_t start = call_stats_start();
+
+	thread_rpc(rpc_args);
+	call_stats_done(CALL_STATS_RPC, cmd, start);
+}
+
 uint32_t thread_rpc_cmd(uint32_t cmd, size_t num_params,
 			struct thread_param *params)
 {
@@ -499,7 +518,7 @@ uint32_t thread_rpc_cmd(uint32_t cmd, size_t num_params,
 		return ret;
 
 	reg_pair_from_64(carg, rpc_args + 1, rpc_args + 2);
-	thread_rpc(rpc_args);
+	thread_rpc_timed(cmd, rpc_args);
 
 	return get_rpc_arg_res(arg, num_params, params);
 }
@@ -526,7 +545,7 @@ static void thread_rpc_free(unsigned int bt, uint64_t cookie, struct mobj *mobj)
 
 	if (!ret) {
 		reg_pair_from_64(carg, rpc_args + 1, rpc_args + 2);
-		thread_rpc(rpc_args);
+		thread_rpc_timed(OPTEE_RPC_CMD_SHM_FREE, rpc_args);
 	}
 }
 
@@ -589,7 +608,7 @@ static struct mobj *thread_rpc_alloc(size_t size, size_t align, unsigned int bt)
 		return NULL;
 
 	reg_pair_from_64(carg, rpc_args + 1, rpc_args + 2);
-	thread_rpc(rpc_args);
+	thread_rpc_timed(OPTEE_RPC_CMD_SHM_ALLOC, rpc_args);
 
 	return get_rpc_alloc_res(arg, bt, size);
 }
@@ -48,14 +48,25 @@ struct thread_shm_cache_entry {
 	size_t size;
 	enum thread_shm_type type;
 	enum thread_shm_cache_user user;
+	unsigned int last_used;
 	SLIST_ENTRY(thread_shm_cache_entry) link;
 };
 
-SLIST_HEAD(thread_shm_cache, thread_shm_cache_entry);
+/*
+ * struct thread_shm_cache - RPC shared memory cached by a thread
+ * @list:	cached buffers, several buffers may belong to the same user
+ * @seq:	incremented for each allocation from the cache, used to find
+ *		the least recently used and idle buffers
+ */
+struct thread_shm_cache {
+	SLIST_HEAD(, thread_shm_cache_entry) list;
+	unsigned int seq;
+};
 
 struct thread_ctx {
 	struct thread_ctx_regs regs;
 	enum thread_state state;
+	size_t last_core_pos;	/* Core which last freed the thread */
 	vaddr_t stack_va_end;
 	uint32_t flags;
 	struct core_mmu_user_map user_map;
@@ -1582,6 +1582,76 @@ static void set_region(struct core_mmu_table_info *tbl_info,
 	}
 }
 
+/*
+ * Returns true if the part of @region at @va can be mapped with a single
+ * block (LPAE) or section (v7) descriptor in the directory table instead
+ * of a translation table with small pages. That requires an unpaged and
+ * physically contiguous mobj with both @va and the physical address
+ * aligned to CORE_MMU_PGDIR_SIZE, and the region must cover the entire
+ * directory entry.
+ */
+static bool can_map_pg_block(struct vm_region *region, vaddr_t va,
+			     vaddr_t end, paddr_t *pa)
+{
+	size_t offset = va - region->va + region->offset;
+
+	if (mobj_is_paged(region->mobj) || region->mobj->phys_granule)
+		return false;
+	if ((va & CORE_MMU_PGDIR_MASK) || end - va < CORE_MMU_PGDIR_SIZE)
+		return false;
+	if (mobj_get_pa(region->mobj, offset, 0, pa))
+		return false;
+
+	return !(*pa & CORE_MMU_PGDIR_MASK);
+}
+
+struct pgdir_block_iter {
+	struct vm_region *region;
+};
+
+/*
+ * Callback for pgt_alloc() returning true if the directory entry at @va
+ * is mapped with a block descriptor by set_pg_region(). @va is increasing
+ * between calls so the region iterator only moves forward.
+ */
+static bool pgdir_is_block(void *arg, vaddr_t va)
+{
+	struct pgdir_block_iter *iter = arg;
+	struct vm_region *r = iter->region;
+	paddr_t pa = 0;
+
+	while (r && r->va + r->size <= va)
+		r = TAILQ_NEXT(r, link);
+	iter->region = r;
+
+	if (!r || r->va > va)
+		return false;
+	return can_map_pg_block(r, va, r->va + r->size, &pa);
+}
+
+bool core_mmu_clear_user_blocks(vaddr_t va, size_t len)
+{
+	struct core_mmu_table_info dir_info = { };
+	vaddr_t end = ROUNDUP(va + len, CORE_MMU_PGDIR_SIZE);
+	bool cleared = false;
+	uint32_t attr = 0;
+	unsigned int idx = 0;
+
+	core_mmu_get_user_pgdir(&dir_info);
+	for (va = ROUNDDOWN(va, CORE_MMU_PGDIR_SIZE); va < end;
+	     va += CORE_MMU_PGDIR_SIZE) {
+		idx = core_mmu_va2idx(&dir_info, va);
+		core_mmu_get_entry(&dir_info, idx, NULL, &attr);
+		if ((attr & TEE_MATTR_VALID_BLOCK) &&
+		    !(attr & TEE_MATTR_TABLE)) {
+			core_mmu_set_entry(&dir_info, idx, 0, 0);
+			cleared = true;
+		}
+	}
+
+	return cleared;
+}
+
 static void set_pg_region(struct core_mmu_table_info *dir_info,
 			struct vm_region *region, struct pgt **pgt,
 			struct core_mmu_table_info *pg_info)
@@ -1595,6 +1665,15 @@ static void set_pg_region(struct core_mmu_table_info *dir_info,
 	uint32_t pgt_attr = (r.attr & TEE_MATTR_SECURE) | TEE_MATTR_TABLE;
 
 	while (r.va < end) {
+		if (can_map_pg_block(region, r.va, end, &r.pa)) {
+			/* No page table is allocated, see pgdir_is_block() */
+			core_mmu_set_entry(dir_info,
+					   core_mmu_va2idx(dir_info, r.va),
+					   r.pa, r.attr);
+			r.va += CORE_MMU_PGDIR_SIZE;
+			continue;
+		}
+
 		if (!pg_info->table ||
 		     r.va >= (pg_info->va_base + CORE_MMU_PGDIR_SIZE)) {
 			/*
@@ -1915,6 +1994,7 @@ void core_mmu_populate_user_map(struct core_mmu_table_info *dir_info,
 {
 	struct core_mmu_table_info pg_info = { };
 	struct pgt_cache *pgt_cache = &thread_get_tsd()->pgt_cache;
+	struct pgdir_block_iter iter = { };
 	struct pgt *pgt = NULL;
 	struct vm_region *r = NULL;
 	struct vm_region *r_last = NULL;
@@ -1928,8 +2008,9 @@ void core_mmu_populate_user_map(struct core_mmu_table_info *dir_info,
 	/*
 	 * Allocate all page tables in advance.
 	 */
+	iter.region = r;
 	pgt_alloc(pgt_cache, uctx->ts_ctx, r->va,
-		  r_last->va + r_last->size - 1);
+		  r_last->va + r_last->size - 1, pgdir_is_block, &iter);
 	pgt = SLIST_FIRST(pgt_cache);
 
 	core_mmu_set_info_table(&pg_info, dir_info->level + 1, 0, NULL);
@@ -55,14 +55,32 @@ static size_t mobj_reg_shm_size(size_t nr_pages)
 	return s;
 }
 
-static SLIST_HEAD(reg_shm_head, mobj_reg_shm) reg_shm_list =
-	SLIST_HEAD_INITIALIZER(reg_shm_head);
+/*
+ * Registered shared memory objects are looked up by cookie on each std
+ * call referencing them, keep them in a hash table indexed by cookie to
+ * keep the lookups cheap with many registered buffers.
+ */
+#define REG_SHM_HASH_SIZE	64
+
+SLIST_HEAD(reg_shm_head, mobj_reg_shm);
+
+static struct reg_shm_head reg_shm_hash[REG_SHM_HASH_SIZE];
 
 static unsigned int reg_shm_slist_lock = SPINLOCK_UNLOCK;
 static unsigned int reg_shm_map_lock = SPINLOCK_UNLOCK;
 
 static struct mobj_reg_shm *to_mobj_reg_shm(struct mobj *mobj);
 
+static struct reg_shm_head *reg_shm_hash_head(uint64_t cookie)
+{
+	/* Cookies are often addresses, mix in the upper bits too */
+	uint32_t h = cookie ^ (cookie >> 32);
+
+	h ^= h >> 16;
+	h ^= h >> 8;
+	return reg_shm_hash + h % REG_SHM_HASH_SIZE;
+}
+
 static TEE_Result mobj_reg_shm_get_pa(struct mobj *mobj, size_t offst,
 				      size_t granule, paddr_t *pa)
 {
@@ -121,6 +139,17 @@ static void reg_shm_unmap_helper(struct mobj_reg_shm *r)
 	r->mm = NULL;
 }
 
+/*
+ * Must be called with reg_shm_slist_lock held, once the object is removed
+ * from the hash table it's only reachable by the caller which must call
+ * reg_shm_free_helper() after releasing reg_shm_slist_lock.
+ */
+static void reg_shm_unlink_helper(struct mobj_reg_shm *mobj_reg_shm)
+{
+	SLIST_REMOVE(reg_shm_hash_head(mobj_reg_shm->cookie), mobj_reg_shm,
+		     mobj_reg_shm, next);
+}
+
 static void reg_shm_free_helper(struct mobj_reg_shm *mobj_reg_shm)
 {
 	uint32_t exceptions = cpu_spin_lock_xsave(&reg_shm_map_lock);
@@ -130,7 +159,6 @@ static void reg_shm_free_helper(struct mobj_reg_shm *mobj_reg_shm)
 
 	cpu_spin_unlock_xrestore(&reg_shm_map_lock, exceptions);
 
-	SLIST_REMOVE(&reg_shm_list, mobj_reg_shm, mobj_reg_shm, next);
 	free(mobj_reg_shm);
 }
 
@@ -148,8 +176,9 @@ static void mobj_reg_shm_free(struct mobj *mobj)
 		 * the mobj to be released.
 		 */
 		exceptions = cpu_spin_lock_xsave(&reg_shm_slist_lock);
-		reg_shm_free_helper(r);
+		reg_shm_unlink_helper(r);
 		cpu_spin_unlock_xrestore(&reg_shm_slist_lock, exceptions);
+		reg_shm_free_helper(r);
 	} else {
 		/*
 		 * We've reached the point where an unguarded reg shm can
@@ -332,7 +361,7 @@ struct mobj *mobj_reg_shm_alloc(paddr_t *pages, size_t num_pages,
 	}
 
 	exceptions = cpu_spin_lock_xsave(&reg_shm_slist_lock);
-	SLIST_INSERT_HEAD(&reg_shm_list, mobj_reg_shm, next);
+	SLIST_INSERT_HEAD(reg_shm_hash_head(cookie), mobj_reg_shm, next);
 	cpu_spin_unlock_xrestore(&reg_shm_slist_lock, exceptions);
 
 	return &mobj_reg_shm->mobj;
@@ -353,7 +382,7 @@ static struct mobj_reg_shm *reg_shm_find_unlocked(uint64_t cookie)
 {
 	struct mobj_reg_shm *mobj_reg_shm = NULL;
 
-	SLIST_FOREACH(mobj_reg_shm, &reg_shm_list, next)
+	SLIST_FOREACH(mobj_reg_shm, reg_shm_hash_head(cookie), next)
 		if (mobj_reg_shm->cookie == cookie)
 			return mobj_reg_shm;
 
@@ -411,15 +440,18 @@ TEE_Result mobj_reg_shm_release_by_cookie(uint64_t cookie)
 	assert(shm_release_waiters);
 
 	while (true) {
+		bool release_frees = false;
+
 		exceptions = cpu_spin_lock_xsave(&reg_shm_slist_lock);
-		if (r->release_frees) {
-			reg_shm_free_helper(r);
-			r = NULL;
-		}
+		release_frees = r->release_frees;
+		if (release_frees)
+			reg_shm_unlink_helper(r);
 		cpu_spin_unlock_xrestore(&reg_shm_slist_lock, exceptions);
 
-		if (!r)
+		if (release_frees) {
+			reg_shm_free_helper(r);
 			break;
+		}
 		condvar_wait(&shm_cv, &shm_mu);
 	}
 
@@ -52,8 +52,18 @@ static struct pgt_cache pgt_free_list = SLIST_HEAD_INITIALIZER(pgt_free_list);
  * the context (page tables holding valid physical pages) are saved in this
  * cache in the hope that some of the valid physical pages may still be
  * valid when the context is mapped again.
+ *
+ * Cached page tables are looked up by (ctx, vabase) in pgt_cache_hash.
+ * The same page tables are also linked in pgt_cache_lru in the order they
+ * were cached, the first one is the victim when we run out of free page
+ * tables.
  */
-static struct pgt_cache pgt_cache_list = SLIST_HEAD_INITIALIZER(pgt_cache_list);
+LIST_HEAD(pgt_hash_head, pgt);
+TAILQ_HEAD(pgt_lru_head, pgt);
+
+static struct pgt_hash_head pgt_cache_hash[PGT_CACHE_SIZE];
+static struct pgt_lru_head pgt_cache_lru =
+	TAILQ_HEAD_INITIALIZER(pgt_cache_lru);
 #endif
 
 static struct pgt pgt_entries[PGT_CACHE_SIZE];
@@ -168,9 +178,23 @@ static void push_to_free_list(struct pgt *p)
 #endif
 
 #ifdef CFG_PAGED_USER_TA
+static struct pgt_hash_head *get_hash_head(void *ctx, vaddr_t vabase)
+{
+	vaddr_t h = (vabase >> CORE_MMU_PGDIR_SHIFT) ^ ((vaddr_t)ctx >> 4);
+
+	return pgt_cache_hash + h % ARRAY_SIZE(pgt_cache_hash);
+}
+
 static void push_to_cache_list(struct pgt *pgt)
 {
-	SLIST_INSERT_HEAD(&pgt_cache_list, pgt, link);
+	LIST_INSERT_HEAD(get_hash_head(pgt->ctx, pgt->vabase), pgt, hash_link);
+	TAILQ_INSERT_TAIL(&pgt_cache_lru, pgt, lru_link);
+}
+
+static void remove_from_cache_list(struct pgt *pgt)
+{
+	LIST_REMOVE(pgt, hash_link);
+	TAILQ_REMOVE(&pgt_cache_lru, pgt, lru_link);
 }
 
 static bool match_pgt(struct pgt *pgt, vaddr_t vabase, void *ctx)
@@ -180,64 +204,35 @@ static bool match_pgt(struct pgt *pgt, vaddr_t vabase, void *ctx)
 
 static struct pgt *pop_from_cache_list(vaddr_t vabase, void *ctx)
 {
-	struct pgt *pgt;
-	struct pgt *p;
+	struct pgt *pgt = NULL;
 
-	pgt = SLIST_FIRST(&pgt_cache_list);
-	if (!pgt)
-		return NULL;
-	if (match_pgt(pgt, vabase, ctx)) {
-		SLIST_REMOVE_HEAD(&pgt_cache_list, link);
-		return pgt;
-	}
-
-	while (true) {
-		p = SLIST_NEXT(pgt, link);
-		if (!p)
-			break;
-		if (match_pgt(p, vabase, ctx)) {
-			SLIST_REMOVE_AFTER(pgt, link);
-			break;
+	LIST_FOREACH(pgt, get_hash_head(ctx, vabase), hash_link) {
+		if (match_pgt(pgt, vabase, ctx)) {
+			remove_from_cache_list(pgt);
+			return pgt;
 		}
-		pgt = p;
 	}
-	return p;
+
+	return NULL;
 }
 
-static struct pgt *pop_least_used_from_cache_list(void)
+static struct pgt *pop_least_recently_used_from_cache_list(void)
 {
-	struct pgt *pgt;
-	struct pgt *p_prev = NULL;
-	size_t least_used;
-
-	pgt = SLIST_FIRST(&pgt_cache_list);
-	if (!pgt)
-		return NULL;
-	if (!pgt->num_used_entries)
-		goto out;
-	least_used = pgt->num_used_entries;
+	struct pgt *pgt = TAILQ_FIRST(&pgt_cache_lru);
 
-	while (true) {
-		if (!SLIST_NEXT(pgt, link))
-			break;
-		if (SLIST_NEXT(pgt, link)->num_used_entries <= least_used) {
-			p_prev = pgt;
-			least_used = SLIST_NEXT(pgt, link)->num_used_entries;
-		}
-		pgt = SLIST_NEXT(pgt, link);
-	}
-
-out:
-	if (p_prev) {
-		pgt = SLIST_NEXT(p_prev, link);
-		SLIST_REMOVE_AFTER(p_prev, link);
-	} else {
-		pgt = SLIST_FIRST(&pgt_cache_list);
-		SLIST_REMOVE_HEAD(&pgt_cache_list, link);
-	}
+	if (pgt)
+		remove_from_cache_list(pgt);
 	return pgt;
 }
 
+static void flush_pgt_entry(struct pgt *p)
+{
+	tee_pager_pgt_save_and_release_entries(p);
+	assert(!p->num_used_entries);
+	p->ctx = NULL;
+	p->vabase = 0;
+}
+
 static void pgt_free_unlocked(struct pgt_cache *pgt_cache, bool save_ctx)
 {
 	while (!SLIST_EMPTY(pgt_cache)) {
@@ -247,11 +242,7 @@ static void pgt_free_unlocked(struct pgt_cache *pgt_cache, bool save_ctx)
 		if (save_ctx && p->num_used_entries) {
 			push_to_cache_list(p);
 		} else {
-			tee_pager_pgt_save_and_release_entries(p);
-			assert(!p->num_used_entries);
-			p->ctx = NULL;
-			p->vabase = 0;
-
+			flush_pgt_entry(p);
 			push_to_free_list(p);
 		}
 	}
@@ -265,7 +256,7 @@ static struct pgt *pop_from_some_list(vaddr_t vabase, void *ctx)
 		return p;
 	p = pop_from_free_list();
 	if (!p) {
-		p = pop_least_used_from_cache_list();
+		p = pop_least_recently_used_from_cache_list();
 		if (!p)
 			return NULL;
 		tee_pager_pgt_save_and_release_entries(p);
@@ -277,56 +268,27 @@ static struct pgt *pop_from_some_list(vaddr_t vabase, void *ctx)
 	return p;
 }
 
+static void flush_cache_entry(struct pgt *p)
+{
+	remove_from_cache_list(p);
+	flush_pgt_entry(p);
+	push_to_free_list(p);
+}
+
 void pgt_flush_ctx(struct ts_ctx *ctx)
 {
-	struct pgt *p;
-	struct pgt *pp = NULL;
+	struct pgt *p = NULL;
+	struct pgt *next_p = NULL;
 
 	mutex_lock(&pgt_mu);
 
-	while (true) {
-		p = SLIST_FIRST(&pgt_cache_list);
-		if (!p)
-			goto out;
-		if (p->ctx != ctx)
-			break;
-		SLIST_REMOVE_HEAD(&pgt_cache_list, link);
-		tee_pager_pgt_save_and_release_entries(p);
-		assert(!p->num_used_entries);
-		p->ctx = NULL;
-		p->vabase = 0;
-		push_to_free_list(p);
-	}
+	TAILQ_FOREACH_SAFE(p, &pgt_cache_lru, lru_link, next_p)
+		if (p->ctx == ctx)
+			flush_cache_entry(p);
 
-	pp = p;
-	while (true) {
-		p = SLIST_NEXT(pp, link);
-		if (!p)
-			break;
-		if (p->ctx == ctx) {
-			SLIST_REMOVE_AFTER(pp, link);
-			tee_pager_pgt_save_and_release_entries(p);
-			assert(!p->num_used_entries);
-			p->ctx = NULL;
-			p->vabase = 0;
-			push_to_free_list(p);
-		} else {
-			pp = p;
-		}
-	}
-
-out:
 	mutex_unlock(&pgt_mu);
 }
 
-static void flush_pgt_entry(struct pgt *p)
-{
-	tee_pager_pgt_save_and_release_entries(p);
-	assert(!p->num_used_entries);
-	p->ctx = NULL;
-	p->vabase = 0;
-}
-
 static bool pgt_entry_matches(struct pgt *p, void *ctx, vaddr_t begin,
 			      vaddr_t last)
 {
@@ -387,6 +349,39 @@ static void flush_ctx_range_from_list(struct pgt_cache *pgt_cache, void *ctx,
 	}
 }
 
+static void flush_ctx_range_from_cache(void *ctx, vaddr_t begin, vaddr_t last)
+{
+	vaddr_t va = ROUNDDOWN(begin, CORE_MMU_PGDIR_SIZE);
+	struct pgt *next_p = NULL;
+	struct pgt *p = NULL;
+	size_t num_tbls = 0;
+	size_t n = 0;
+
+	if (last <= begin)
+		return;
+
+	/*
+	 * Small ranges are looked up table by table in the hash, large
+	 * ranges are cheaper to match against each cached entry instead.
+	 */
+	num_tbls = ((last - 1 - va) >> CORE_MMU_PGDIR_SHIFT) + 1;
+	if (num_tbls > PGT_CACHE_SIZE) {
+		TAILQ_FOREACH_SAFE(p, &pgt_cache_lru, lru_link, next_p)
+			if (pgt_entry_matches(p, ctx, begin, last))
+				flush_cache_entry(p);
+		return;
+	}
+
+	for (n = 0; n < num_tbls; n++) {
+		struct pgt_hash_head *head = NULL;
+
+		head = get_hash_head(ctx, va + n * CORE_MMU_PGDIR_SIZE);
+		LIST_FOREACH_SAFE(p, head, hash_link, next_p)
+			if (pgt_entry_matches(p, ctx, begin, last))
+				flush_cache_entry(p);
+	}
+}
+
 void pgt_flush_ctx_range(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
 			 vaddr_t begin, vaddr_t last)
 {
@@ -394,7 +389,7 @@ void pgt_flush_ctx_range(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
 
 	if (pgt_cache)
 		flush_ctx_range_from_list(pgt_cache, ctx, begin, last);
-	flush_ctx_range_from_list(&pgt_cache_list, ctx, begin, last);
+	flush_ctx_range_from_cache(ctx, begin, last);
 
 	condvar_broadcast(&pgt_cv);
 	mutex_unlock(&pgt_mu);
@@ -425,37 +420,52 @@ static struct pgt *pop_from_some_list(vaddr_t vabase,
 }
 #endif /*!CFG_PAGED_USER_TA*/
 
-static void clear_ctx_range_from_list(struct pgt_cache *pgt_cache,
-				      void *ctx __maybe_unused,
-				      vaddr_t begin, vaddr_t end)
+static void clear_pgt_range(struct pgt *p, vaddr_t begin, vaddr_t end)
 {
-	struct pgt *p = NULL;
 #ifdef CFG_WITH_LPAE
-	uint64_t *tbl = NULL;
+	uint64_t *tbl = p->tbl;
 #else
-	uint32_t *tbl = NULL;
+	uint32_t *tbl = p->tbl;
 #endif
+	vaddr_t b = MAX(p->vabase, begin);
+	vaddr_t e = MIN(p->vabase + CORE_MMU_PGDIR_SIZE, end);
 	unsigned int idx = 0;
 	unsigned int n = 0;
 
-	SLIST_FOREACH(p, pgt_cache, link) {
-		vaddr_t b = MAX(p->vabase, begin);
-		vaddr_t e = MIN(p->vabase + CORE_MMU_PGDIR_SIZE, end);
+	if (b >= e)
+		return;
+
+	idx = (b - p->vabase) / SMALL_PAGE_SIZE;
+	n = (e - b) / SMALL_PAGE_SIZE;
+	memset(tbl + idx, 0, n * sizeof(*tbl));
+}
+
+static void clear_ctx_range_from_list(struct pgt_cache *pgt_cache,
+				      void *ctx __maybe_unused,
+				      vaddr_t begin, vaddr_t end)
+{
+	struct pgt *p = NULL;
 
+	SLIST_FOREACH(p, pgt_cache, link) {
 #ifdef CFG_PAGED_USER_TA
 		if (p->ctx != ctx)
 			continue;
 #endif
-		if (b >= e)
-			continue;
-
-		tbl = p->tbl;
-		idx = (b - p->vabase) / SMALL_PAGE_SIZE;
-		n = (e - b) / SMALL_PAGE_SIZE;
-		memset(tbl + idx, 0, n * sizeof(*tbl));
+		clear_pgt_range(p, begin, end);
 	}
 }
 
+#ifdef CFG_PAGED_USER_TA
+static void clear_ctx_range_from_cache(void *ctx, vaddr_t begin, vaddr_t end)
+{
+	struct pgt *p = NULL;
+
+	TAILQ_FOREACH(p, &pgt_cache_lru, lru_link)
+		if (p->ctx == ctx)
+			clear_pgt_range(p, begin, end);
+}
+#endif
+
 void pgt_clear_ctx_range(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
 			 vaddr_t begin, vaddr_t end)
 {
@@ -464,14 +474,16 @@ void pgt_clear_ctx_range(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
 	if (pgt_cache)
 		clear_ctx_range_from_list(pgt_cache, ctx, begin, end);
 #ifdef CFG_PAGED_USER_TA
-	clear_ctx_range_from_list(&pgt_cache_list, ctx, begin, end);
+	clear_ctx_range_from_cache(ctx, begin, end);
 #endif
 
 	mutex_unlock(&pgt_mu);
 }
 
 static bool pgt_alloc_unlocked(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
-			       vaddr_t begin, vaddr_t last)
+			       vaddr_t begin, vaddr_t last,
+			       bool (*skip)(void *skip_arg, vaddr_t va),
+			       void *skip_arg)
 {
 	const vaddr_t base = ROUNDDOWN(begin, CORE_MMU_PGDIR_SIZE);
 	const size_t num_tbls = ((last - base) >> CORE_MMU_PGDIR_SHIFT) + 1;
@@ -479,8 +491,13 @@ static bool pgt_alloc_unlocked(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
 	struct pgt *p;
 	struct pgt *pp = NULL;
 
-	while (n < num_tbls) {
-		p = pop_from_some_list(base + n * CORE_MMU_PGDIR_SIZE, ctx);
+	for (n = 0; n < num_tbls; n++) {
+		vaddr_t vabase = base + n * CORE_MMU_PGDIR_SIZE;
+
+		if (skip && skip(skip_arg, vabase))
+			continue;
+
+		p = pop_from_some_list(vabase, ctx);
 		if (!p) {
 			pgt_free_unlocked(pgt_cache, ctx);
 			return false;
@@ -491,14 +508,14 @@ static bool pgt_alloc_unlocked(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
 		else
 			SLIST_INSERT_HEAD(pgt_cache, p, link);
 		pp = p;
-		n++;
 	}
 
 	return true;
 }
 
 void pgt_alloc(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
-	       vaddr_t begin, vaddr_t last)
+	       vaddr_t begin, vaddr_t last,
+	       bool (*skip)(void *skip_arg, vaddr_t va), void *skip_arg)
 {
 	if (last <= begin)
 		return;
@@ -506,7 +523,8 @@ void pgt_alloc(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
 	mutex_lock(&pgt_mu);
 
 	pgt_free_unlocked(pgt_cache, ctx);
-	while (!pgt_alloc_unlocked(pgt_cache, ctx, begin, last)) {
+	while (!pgt_alloc_unlocked(pgt_cache, ctx, begin, last, skip,
+				   skip_arg)) {
 		DMSG("Waiting for page tables");
 		condvar_broadcast(&pgt_cv);
 		condvar_wait(&pgt_cv, &pgt_mu);
@@ -678,10 +678,28 @@ static struct vm_paged_region *find_region(struct vm_paged_region_head *regions,
 static struct vm_paged_region *find_uta_region(vaddr_t va)
 {
 	struct ts_ctx *ctx = thread_get_tsd()->ctx;
+	struct vm_paged_region_head *regions = NULL;
+	struct vm_paged_region *reg = NULL;
 
 	if (!is_user_mode_ctx(ctx))
 		return NULL;
-	return find_region(to_user_mode_ctx(ctx)->regions, va);
+
+	regions = to_user_mode_ctx(ctx)->regions;
+	if (!regions)
+		return NULL;
+
+	/*
+	 * User mode regions are sorted on base address, see
+	 * tee_pager_add_um_region(), so we can stop as soon as we've
+	 * passed va.
+	 */
+	TAILQ_FOREACH(reg, regions, link) {
+		if (reg->base > va)
+			break;
+		if (va - reg->base < reg->size)
+			return reg;
+	}
+	return NULL;
 }
 #else
 static struct vm_paged_region *find_uta_region(vaddr_t va __unused)
@@ -835,7 +853,8 @@ TEE_Result tee_pager_add_um_region(struct user_mode_ctx *uctx, vaddr_t base,
 	return TEE_SUCCESS;
 }
 
-static void split_region(struct vm_paged_region *reg,
+static void split_region(struct vm_paged_region_head *regions,
+			 struct vm_paged_region *reg,
 			 struct vm_paged_region *r2, vaddr_t va)
 {
 	uint32_t exceptions = pager_lock_check_stack(64);
@@ -860,7 +879,8 @@ static void split_region(struct vm_paged_region *reg,
 		r2->pgt_array[n - n0] = reg->pgt_array[n];
 	reg->size = diff;
 
-	TAILQ_INSERT_BEFORE(reg, r2, link);
+	/* Keep the list sorted on base address, see find_uta_region() */
+	TAILQ_INSERT_AFTER(regions, reg, r2, link);
 	TAILQ_INSERT_AFTER(&reg->fobj->regions, reg, r2, fobj_link);
 
 	pager_unlock(exceptions);
@@ -884,7 +904,7 @@ TEE_Result tee_pager_split_um_region(struct user_mode_ctx *uctx, vaddr_t va)
 			r2 = alloc_region(va, reg->size - diff);
 			if (!r2)
 				return TEE_ERROR_OUT_OF_MEMORY;
-			split_region(reg, r2, va);
+			split_region(uctx->regions, reg, r2, va);
 			return TEE_SUCCESS;
 		}
 	}
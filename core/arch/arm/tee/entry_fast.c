@@ -93,8 +93,11 @@ static void tee_entry_exchange_capabilities(struct thread_smc_args *args)
 	if (IS_ENABLED(CFG_VIRTUALIZATION))
 		args->a1 |= OPTEE_SMC_SEC_CAP_VIRTUALIZATION;
 	args->a1 |= OPTEE_SMC_SEC_CAP_MEMREF_NULL;
+	if (IS_ENABLED(CFG_CORE_INVOKE_BATCH))
+		args->a1 |= OPTEE_SMC_SEC_CAP_INVOKE_BATCH;
 	if (IS_ENABLED(CFG_CORE_ASYNC_NOTIF)) {
 		args->a1 |= OPTEE_SMC_SEC_CAP_ASYNC_NOTIF;
+		args->a1 |= OPTEE_SMC_SEC_CAP_INVOKE_ASYNC;
 		args->a2 = NOTIF_VALUE_MAX;
 	}
 	DMSG("Asynchronous notifications are %sabled",
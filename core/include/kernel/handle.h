@@ -9,12 +9,21 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/*
+ * struct handle_db - handle database
+ * @ptrs:	pointers associated with the handles, NULL if unused
+ * @free_idx:	stack of unused handles, @max_ptrs entries allocated
+ * @num_free:	number of handles in @free_idx
+ * @max_ptrs:	number of allocated entries in @ptrs
+ */
 struct handle_db {
 	void **ptrs;
+	int *free_idx;
+	size_t num_free;
 	size_t max_ptrs;
 };
 
-#define HANDLE_DB_INITIALIZER { NULL, 0 }
+#define HANDLE_DB_INITIALIZER { NULL, NULL, 0, 0 }
 
 /*
  * Frees all internal data structures of the database, but does not free
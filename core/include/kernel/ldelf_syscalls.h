@@ -19,6 +19,13 @@ struct system_ctx {
 	const struct ts_store_ops *store_op;
 };
 
+/*
+ * Allocates TA memory with fobj_ta_mem_alloc(). If that fails the memory
+ * held by caches of unused binaries and by idle TA instances is released
+ * and the allocation is tried once more.
+ */
+struct fobj *ldelf_ta_mem_alloc(unsigned int num_pages);
+
 TEE_Result ldelf_syscall_map_zi(vaddr_t *va, size_t num_bytes, size_t pad_begin,
 				size_t pad_end, unsigned long flags);
 TEE_Result ldelf_syscall_unmap(vaddr_t va, size_t num_bytes);
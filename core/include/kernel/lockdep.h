@@ -28,11 +28,39 @@ struct lockdep_edge {
 
 STAILQ_HEAD(lockdep_edge_head, lockdep_edge);
 
+/* Number of call sites waiting for a lock tracked by the profiler */
+#define LOCKDEP_PROFILE_NUM_SITES	4
+
+struct lockdep_call_site {
+	vaddr_t addr;
+	uint32_t count;
+};
+
+/*
+ * Contention profile of a lock, only updated with CFG_LOCKDEP_PROFILE=y.
+ * Times are in counter ticks. @sites holds the call sites which most
+ * often had to wait for the lock.
+ */
+struct lockdep_profile {
+	uint32_t acquired;
+	uint32_t contended;
+	uint64_t wait_ticks;
+	uint64_t hold_ticks;
+	struct lockdep_call_site sites[LOCKDEP_PROFILE_NUM_SITES];
+};
+
+/* Copy of the profile of lock @lock_id, see lockdep_graph_get_profile() */
+struct lockdep_profile_entry {
+	uintptr_t lock_id;
+	struct lockdep_profile profile;
+};
+
 struct lockdep_node {
 	uintptr_t lock_id; /* For instance, address of actual lock object */
 	struct lockdep_edge_head edges;
 	TAILQ_ENTRY(lockdep_node) link;
 	uint8_t flags; /* Used temporarily when walking the graph */
+	struct lockdep_profile profile;
 };
 
 TAILQ_HEAD(lockdep_node_head, lockdep_node);
@@ -42,6 +70,7 @@ TAILQ_HEAD(lockdep_node_head, lockdep_node);
 struct lockdep_lock {
 	struct lockdep_node *node;
 	vaddr_t *call_stack;
+	uint64_t acquired_at;
 	TAILQ_ENTRY(lockdep_lock) link;
 };
 
@@ -130,9 +159,46 @@ static inline void lockdep_lock_release(struct lockdep_lock_head *owned,
  */
 void lockdep_lock_destroy(struct lockdep_node_head *graph, uintptr_t id);
 
+/*
+ * Record that lock @id in @owned was acquired at @now after waiting
+ * @wait_ticks, @contended tells if the lock was held by someone else when
+ * @site tried to take it.
+ */
+void lockdep_lock_profile_acquired(struct lockdep_lock_head *owned,
+				   uintptr_t id, uint64_t now,
+				   uint64_t wait_ticks, bool contended,
+				   vaddr_t site);
+
+/*
+ * Record that lock @id in @owned is about to be released at @now. Must be
+ * called before lockdep_lock_release().
+ */
+void lockdep_lock_profile_release(struct lockdep_lock_head *owned,
+				  uintptr_t id, uint64_t now);
+
+/* Returns the number of locks in @graph with a profile to report */
+size_t lockdep_graph_count_profiles(struct lockdep_node_head *graph);
+
+/*
+ * Copies the profile of at most @max_entries locks in @graph into
+ * @entries, the locks with the longest total wait time first, and
+ * returns the number of copied entries. The profiles of all locks are
+ * cleared if @reset is true.
+ */
+size_t lockdep_graph_get_profile(struct lockdep_node_head *graph,
+				 struct lockdep_profile_entry *entries,
+				 size_t max_entries, bool reset);
+
+/* Prints @count profile entries as returned by lockdep_graph_get_profile() */
+void lockdep_print_profile(struct lockdep_profile_entry *entries,
+			   size_t count);
+
 /* Initialize lockdep for mutex objects (kernel/mutex.h) */
 void mutex_lockdep_init(void);
 
+/* Print the contention profile of all mutexes */
+void mutex_lockdep_print_profile(bool reset);
+
 #else /* CFG_LOCKDEP */
 
 static inline void lockdep_lock_acquire(struct lockdep_node_head *g __unused,
@@ -152,6 +218,9 @@ lockdep_lock_destroy(struct lockdep_node_head *graph __unused,
 static inline void mutex_lockdep_init(void)
 {}
 
+static inline void mutex_lockdep_print_profile(bool reset __unused)
+{}
+
 #endif /* !CFG_LOCKDEP */
 
 #endif /* !__KERNEL_LOCKDEP_H */
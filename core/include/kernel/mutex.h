@@ -5,6 +5,7 @@
 #ifndef KERNEL_MUTEX_H
 #define KERNEL_MUTEX_H
 
+#include <compiler.h>
 #include <kernel/refcount.h>
 #include <kernel/wait_queue.h>
 #include <sys/queue.h>
@@ -14,9 +15,14 @@ struct mutex {
 	unsigned spin_lock;	/* used when operating on this struct */
 	struct wait_queue wq;
 	short state;		/* -1: write, 0: unlocked, > 0: readers */
+	short owner;		/* thread holding the write lock */
 };
 
-#define MUTEX_INITIALIZER { .wq = WAIT_QUEUE_INITIALIZER }
+/*
+ * .owner is THREAD_ID_INVALID, spelled out since <kernel/thread.h> can't be
+ * included from here.
+ */
+#define MUTEX_INITIALIZER { .wq = WAIT_QUEUE_INITIALIZER, .owner = -1 }
 
 struct recursive_mutex {
 	struct mutex m;		/* used when lock_depth goes 0 -> 1 or 1 -> 0 */
@@ -29,6 +35,18 @@ struct recursive_mutex {
 
 TAILQ_HEAD(mutex_head, mutex);
 
+/*
+ * struct mutex_spin_stats - adaptive spinning statistics
+ * @spins:	number of times a locker started spinning on a held mutex
+ * @spin_acquired: number of spins that ended with the mutex acquired
+ * @sleeps:	number of times a locker had to sleep in normal world
+ */
+struct mutex_spin_stats {
+	uint32_t spins;
+	uint32_t spin_acquired;
+	uint32_t sleeps;
+};
+
 void mutex_init(struct mutex *m);
 void mutex_destroy(struct mutex *m);
 
@@ -36,6 +54,16 @@ void mutex_init_recursive(struct recursive_mutex *m);
 void mutex_destroy_recursive(struct recursive_mutex *m);
 unsigned int mutex_get_recursive_lock_depth(struct recursive_mutex *m);
 
+#if CFG_MUTEX_SPIN_BUDGET
+void mutex_get_spin_stats(struct mutex_spin_stats *stats, bool reset);
+#else
+static inline void mutex_get_spin_stats(struct mutex_spin_stats *stats,
+					bool reset __unused)
+{
+	*stats = (struct mutex_spin_stats){ };
+}
+#endif
+
 #ifdef CFG_MUTEX_DEBUG
 void mutex_unlock_debug(struct mutex *m, const char *fname, int lineno);
 #define mutex_unlock(m) mutex_unlock_debug((m), __FILE__, __LINE__)
@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, The OP-TEE Project Contributors
+ */
+#ifndef KERNEL_REE_FS_TA_H
+#define KERNEL_REE_FS_TA_H
+
+#include <compiler.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <tee_api_types.h>
+
+/*
+ * struct ree_fs_ta_cache_stats - verified TA image cache statistics
+ * @hits:	opens served from the cache
+ * @misses:	opens which had to load and verify the image
+ * @evictions:	images dropped to make room for another one
+ * @invalidations: images dropped due to a TA install, a version update
+ *		or a different image supplied by normal world
+ */
+struct ree_fs_ta_cache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	uint32_t invalidations;
+};
+
+#if defined(CFG_REE_FS_TA_BUFFERED) && CFG_REE_FS_TA_CACHE_ENTRIES
+/* Drops the cached image of TA @uuid, if there's one */
+void ree_fs_ta_cache_invalidate(const TEE_UUID *uuid);
+
+/*
+ * Drops the cached images not used by any handle. The images are held in
+ * the same pool as TA RAM so this is called when allocating TA memory
+ * fails.
+ */
+void ree_fs_ta_cache_drop_unused(void);
+
+void ree_fs_ta_cache_get_stats(struct ree_fs_ta_cache_stats *stats,
+			       bool reset);
+#else
+static inline void ree_fs_ta_cache_invalidate(const TEE_UUID *uuid __unused)
+{
+}
+
+static inline void ree_fs_ta_cache_drop_unused(void)
+{
+}
+
+static inline void
+ree_fs_ta_cache_get_stats(struct ree_fs_ta_cache_stats *stats,
+			  bool reset __unused)
+{
+	*stats = (struct ree_fs_ta_cache_stats){ };
+}
+#endif
+
+#endif /*KERNEL_REE_FS_TA_H*/
@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, The OP-TEE Project Contributors
+ */
+#ifndef KERNEL_RWLOCK_H
+#define KERNEL_RWLOCK_H
+
+#include <compiler.h>
+#include <kernel/mutex.h>
+#include <kernel/wait_queue.h>
+#include <stdbool.h>
+#include <types_ext.h>
+
+/*
+ * Read/write lock for read-mostly data.
+ *
+ * Readers only touch a counter private to the core they execute on, so
+ * concurrent readers on different cores don't bounce a shared cache line
+ * between each other. A reader may be rescheduled on another core while
+ * holding the lock, so a single counter may become negative, only the sum
+ * of all counters is meaningful.
+ *
+ * Writers are serialized with a mutex and have to wait for the readers
+ * to drain. With @writer_pref a waiting writer stops new readers from
+ * entering, otherwise readers keep entering until the writer observes
+ * that all readers have left.
+ *
+ * Readers and writers sleep in normal world when they have to wait. A
+ * reader must not take the lock recursively and an rwlock can't be used
+ * with a condvar.
+ *
+ * The per-core counters are padded to a cache line each rather than
+ * aligned, so they stay on separate cache lines also when the rwlock is
+ * allocated with malloc().
+ */
+#define RWLOCK_READER_COUNT_SIZE	64
+
+struct rwlock_reader_count {
+	uint32_t count;
+	uint8_t pad[RWLOCK_READER_COUNT_SIZE - sizeof(uint32_t)];
+};
+
+struct rwlock {
+	struct mutex m;			/* serializes writers */
+	struct wait_queue read_wq;	/* readers waiting for a writer */
+	struct wait_queue write_wq;	/* writer waiting for readers */
+	uint32_t write_locked;		/* readers must not enter */
+	uint32_t writer_waiting;	/* readers must wake write_wq */
+	bool writer_pref;
+	struct rwlock_reader_count readers[CFG_TEE_CORE_NB_CORE];
+};
+
+#define RWLOCK_INITIALIZER { .m = MUTEX_INITIALIZER, \
+			     .read_wq = WAIT_QUEUE_INITIALIZER, \
+			     .write_wq = WAIT_QUEUE_INITIALIZER }
+
+#define RWLOCK_WRITER_PREF_INITIALIZER { .m = MUTEX_INITIALIZER, \
+					 .read_wq = WAIT_QUEUE_INITIALIZER, \
+					 .write_wq = WAIT_QUEUE_INITIALIZER, \
+					 .writer_pref = true }
+
+void rwlock_init(struct rwlock *rw, bool writer_pref);
+void rwlock_destroy(struct rwlock *rw);
+
+void rwlock_read_lock(struct rwlock *rw);
+bool rwlock_read_trylock(struct rwlock *rw);
+void rwlock_read_unlock(struct rwlock *rw);
+
+void rwlock_write_lock(struct rwlock *rw);
+bool rwlock_write_trylock(struct rwlock *rw);
+void rwlock_write_unlock(struct rwlock *rw);
+
+#endif /*KERNEL_RWLOCK_H*/
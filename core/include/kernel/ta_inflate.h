@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, The OP-TEE Project Contributors
+ */
+#ifndef __KERNEL_TA_INFLATE_H
+#define __KERNEL_TA_INFLATE_H
+
+#include <compiler.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <tee_api_types.h>
+
+/*
+ * Streaming decompression of a TA binary stored as an image of type
+ * SHDR_COMPRESSED_TA. The compressed data is pulled from the TA store
+ * through a fill function into a secure buffer as it's needed, so the
+ * store can hash or decrypt the compressed stream on its way and the image
+ * is verified in a single pass.
+ */
+struct ta_inflate;
+
+/*
+ * Copies at most *@len bytes of compressed data into @buf and updates
+ * *@len with the number of bytes copied, 0 when the end of the compressed
+ * data is reached.
+ */
+typedef TEE_Result (*ta_inflate_fill_t)(void *ctx, uint8_t *buf, size_t *len);
+
+#ifdef CFG_TA_COMPRESSED_IMAGES
+/*
+ * Allocates a decompression context for a binary of @uncompressed_size
+ * bytes compressed with @comp_algo, see enum shdr_comp_algo.
+ */
+TEE_Result ta_inflate_alloc(uint32_t comp_algo, size_t uncompressed_size,
+			    ta_inflate_fill_t fill, void *fill_ctx,
+			    struct ta_inflate **inf);
+
+/*
+ * Decompresses the next @len bytes into @data, or discards them if @data
+ * is NULL. The read completing the binary also checks that the compressed
+ * stream ends there and that all compressed data has been consumed.
+ */
+TEE_Result ta_inflate_read(struct ta_inflate *inf, void *data, size_t len);
+
+/* Returns true once the entire binary has been read */
+bool ta_inflate_done(struct ta_inflate *inf);
+
+void ta_inflate_free(struct ta_inflate *inf);
+#else
+static inline TEE_Result
+ta_inflate_alloc(uint32_t comp_algo __unused, size_t uncompressed_size __unused,
+		 ta_inflate_fill_t fill __unused, void *fill_ctx __unused,
+		 struct ta_inflate **inf __unused)
+{
+	return TEE_ERROR_NOT_SUPPORTED;
+}
+
+static inline TEE_Result ta_inflate_read(struct ta_inflate *inf __unused,
+					 void *data __unused,
+					 size_t len __unused)
+{
+	return TEE_ERROR_NOT_SUPPORTED;
+}
+
+static inline bool ta_inflate_done(struct ta_inflate *inf __unused)
+{
+	return false;
+}
+
+static inline void ta_inflate_free(struct ta_inflate *inf __unused)
+{
+}
+#endif
+
+#endif /*__KERNEL_TA_INFLATE_H*/
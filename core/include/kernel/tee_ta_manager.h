@@ -74,6 +74,8 @@ struct tee_ta_ctx {
 	uint32_t ref_count;	/* Reference counter for multi session TA */
 	bool busy;		/* Context is busy and cannot be entered */
 	struct condvar busy_cv;	/* CV used when context is busy */
+	bool idle;		/* Pre-loaded, never entered instance */
+	TAILQ_ENTRY(tee_ta_ctx) idle_link;
 };
 
 struct tee_ta_session {
@@ -140,6 +142,39 @@ struct tee_ta_session *tee_ta_get_session(uint32_t id, bool exclusive,
 
 void tee_ta_put_session(struct tee_ta_session *sess);
 
+/*
+ * struct tee_ta_open_stats - statistics of tee_ta_open_session()
+ * @count:	number of completed opens
+ * @idle_hits:	opens which reused an idle TA instance
+ * @idle_evictions: idle TA instances destroyed due to the pool limits or
+ *		to free memory
+ * @p50_us:	median open latency in microseconds
+ * @p90_us:	90th percentile of the open latency in microseconds
+ * @p99_us:	99th percentile of the open latency in microseconds
+ *
+ * The latencies are recorded in a log2 histogram of counter ticks so the
+ * percentiles are rounded up to the next power of two ticks.
+ */
+struct tee_ta_open_stats {
+	uint32_t count;
+	uint32_t idle_hits;
+	uint32_t idle_evictions;
+	uint32_t p50_us;
+	uint32_t p90_us;
+	uint32_t p99_us;
+};
+
+void tee_ta_get_open_stats(struct tee_ta_open_stats *stats, bool reset);
+
+/* Unloads the idle instances of TA @uuid, for instance once reinstalled */
+void tee_ta_idle_pool_invalidate(const TEE_UUID *uuid);
+
+/*
+ * Unloads all idle instances to make room when TA memory ran out. Returns
+ * true if something was freed.
+ */
+bool tee_ta_idle_pool_flush(void);
+
 #if defined(CFG_TA_GPROF_SUPPORT)
 void tee_ta_update_session_utime_suspend(void);
 void tee_ta_update_session_utime_resume(void);
@@ -60,6 +60,15 @@ static inline struct user_ta_ctx *to_user_ta_ctx(struct ts_ctx *ctx)
 #ifdef CFG_WITH_USER_TA
 TEE_Result tee_ta_init_user_ta_session(const TEE_UUID *uuid,
 			struct tee_ta_session *s);
+
+/*
+ * Loads an instance of TA @uuid through session @s like
+ * tee_ta_init_user_ta_session(), but the instance is published with no
+ * reference and marked idle so that it can be claimed by the next
+ * session opened to the TA, @s holds no reference on return.
+ */
+TEE_Result tee_ta_init_user_ta_idle(const TEE_UUID *uuid,
+				    struct tee_ta_session *s);
 #else
 static inline TEE_Result tee_ta_init_user_ta_session(
 			const TEE_UUID *uuid __unused,
@@ -67,6 +76,13 @@ static inline TEE_Result tee_ta_init_user_ta_session(
 {
 	return TEE_ERROR_ITEM_NOT_FOUND;
 }
+
+static inline TEE_Result tee_ta_init_user_ta_idle(
+			const TEE_UUID *uuid __unused,
+			struct tee_ta_session *s __unused)
+{
+	return TEE_ERROR_ITEM_NOT_FOUND;
+}
 #endif
 
 
@@ -9,9 +9,23 @@
 #include <sys/queue.h>
 
 struct wait_queue_elem;
-SLIST_HEAD(wait_queue, wait_queue_elem);
 
-#define WAIT_QUEUE_INITIALIZER { .slh_first = NULL }
+/*
+ * struct wait_queue - queue of threads waiting for a sync object
+ * @spin_lock:	protects all the fields below and the elements in the queue
+ * @head:	elements in arrival order
+ * @tail:	last element in @head, NULL if the queue is empty
+ * @num_read_waiters: number of elements waiting for a read lock which
+ *		aren't woken up yet and aren't waiting for a condvar
+ */
+struct wait_queue {
+	unsigned int spin_lock;
+	SLIST_HEAD(, wait_queue_elem) head;
+	struct wait_queue_elem *tail;
+	unsigned int num_read_waiters;
+};
+
+#define WAIT_QUEUE_INITIALIZER { .tail = NULL }
 
 struct condvar;
 struct wait_queue_elem {
@@ -44,11 +58,22 @@ static inline void wq_wait_init(struct wait_queue *wq,
 	wq_wait_init_condvar(wq, wqe, NULL, wait_read);
 }
 
+/*
+ * Removes a wait queue element added with wq_wait_init() when the
+ * condition waited for turned out to be already fulfilled. Replaces the
+ * call to wq_wait_final().
+ */
+void wq_wait_cancel(struct wait_queue *wq, struct wait_queue_elem *wqe);
+
 /* Waits for the wait queue element to the awakened. */
 void wq_wait_final(struct wait_queue *wq, struct wait_queue_elem *wqe,
 		   const void *sync_obj, const char *fname, int lineno);
 
-/* Wakes up the first wait queue element in the wait queue, if there is one */
+/*
+ * Wakes up the first wait queue element in the wait queue, if there is
+ * one. If that element waits for a read lock all elements waiting for a
+ * read lock are woken up.
+ */
 void wq_wake_next(struct wait_queue *wq, const void *sync_obj,
 		const char *fname, int lineno);
 
@@ -57,13 +57,19 @@ void file_unlock(struct file *f);
  * @fobj:	 Fobj holding the data of this slice
  * @page_offset: Offset in pages into the file (@f) where the @fobj is
  *		 located.
+ * @owner:	 Identifies the loader populating @fobj, see
+ *		 file_set_verified()
  *
  * File must be in locked state.
  *
+ * A file kept in the cache by file_set_verified() must only hold slices
+ * from a verified binary, adding a slice to it fails with
+ * TEE_ERROR_BAD_STATE.
+ *
  * Returns TEE_SUCCESS on success or a TEE_ERROR_* code on failure.
  */
 TEE_Result file_add_slice(struct file *f, struct fobj *fobj,
-			  unsigned int page_offset);
+			  unsigned int page_offset, unsigned int owner);
 
 /*
  * file_get() - Increase file reference counter
@@ -105,5 +111,23 @@ void file_put(struct file *f);
  */
 struct file_slice *file_find_slice(struct file *f, unsigned int page_offset);
 
+/*
+ * file_set_verified() - Mark a file as populated from a verified binary
+ * @f:		File pointer
+ * @owner:	Identifies the loader which has completely verified the binary
+ *
+ * File must be in locked state.
+ *
+ * If all slices of @f were added with @owner and
+ * CFG_CORE_FILE_CACHE_ENTRIES > 0, a reference to @f is kept in an LRU
+ * cache so that its read-only slices can be shared by instances loaded
+ * after all current users of @f are gone. Slices added by other loaders
+ * leave @f uncached.
+ */
+void file_set_verified(struct file *f, unsigned int owner);
+
+/* Drops the cached files no one else is using, to free up TA memory */
+void file_cache_drop_unused(void);
+
 #endif /*__MM_FILE_H*/
 
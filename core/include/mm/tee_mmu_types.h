@@ -6,6 +6,7 @@
 #ifndef TEE_MMU_TYPES_H
 #define TEE_MMU_TYPES_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/queue.h>
 #include <util.h>
@@ -107,8 +108,22 @@ struct vm_paged_region {
 TAILQ_HEAD(vm_paged_region_head, vm_paged_region);
 TAILQ_HEAD(vm_region_head, vm_region);
 
+/*
+ * struct vm_info - virtual memory map of a user mode context
+ * @regions:		regions sorted on va
+ * @region_index:	array of the regions sorted on va, used for binary
+ *			search when @region_index_valid is true
+ * @region_index_count:	number of valid entries in @region_index
+ * @region_index_alloc:	number of allocated entries in @region_index
+ * @region_index_valid:	true if @region_index is in sync with @regions
+ * @asid:		ASID of the context
+ */
 struct vm_info {
 	struct vm_region_head regions;
+	struct vm_region **region_index;
+	size_t region_index_count;
+	size_t region_index_alloc;
+	bool region_index_valid;
 	unsigned int asid;
 };
 
@@ -331,6 +331,54 @@ struct optee_msg_arg {
  * OPTEE_MSG_CMD_STOP_ASYNC_NOTIF informs secure world that from now is
  * normal world unable to process asynchronous notifications. Typically
  * used when the driver is shut down.
+ *
+ * OPTEE_MSG_CMD_INVOKE_BATCH invokes several commands, in previously
+ * opened sessions to one or more Trusted Applications, back to back with
+ * a single call. The requests are passed as:
+ * [in/out] param[0].attr		OPTEE_MSG_ATTR_TYPE_VALUE_INOUT
+ * [in]     param[0].u.value.a		number of requests
+ * [out]    param[0].u.value.b		number of requests processed
+ * [in]     param[1].attr		OPTEE_MSG_ATTR_TYPE_TMEM_INOUT or
+ *					OPTEE_MSG_ATTR_TYPE_RMEM_INOUT
+ * [in]     param[1].u.{tmem,rmem}	buffer holding the requests
+ * The buffer holds the requests one after another, each one a struct
+ * optee_msg_arg with cmd OPTEE_MSG_CMD_INVOKE_COMMAND followed by its
+ * num_params parameters. The buffer must be 8 byte aligned. Each request
+ * is updated with its own ret, ret_origin and output parameters as if it
+ * had been invoked with OPTEE_MSG_CMD_INVOKE_COMMAND. Processing stops at
+ * the first malformed request, in which case struct optee_msg_arg::ret
+ * of the batch is TEEC_ERROR_BAD_PARAMETERS.
+ *
+ * OPTEE_MSG_CMD_INVOKE_ASYNC queues an invoke command to be executed
+ * later and returns immediately. Only available with asynchronous
+ * notifications. The request is passed as:
+ * [out] param[0].attr			OPTEE_MSG_ATTR_TYPE_VALUE_OUTPUT
+ * [out] param[0].u.value.a		request id
+ * [out] param[0].u.value.b		asynchronous notification value
+ * [in]  param[1].attr			OPTEE_MSG_ATTR_TYPE_TMEM_INOUT or
+ *					OPTEE_MSG_ATTR_TYPE_RMEM_INOUT
+ * [in]  param[1].u.{tmem,rmem}		buffer holding the request
+ * The buffer holds one request laid out as for OPTEE_MSG_CMD_INVOKE_BATCH
+ * and must remain valid until the request has completed. The returned
+ * asynchronous notification value is signalled each time a request is
+ * queued, to ask normal world to call OPTEE_MSG_CMD_RUN_ASYNC.
+ *
+ * OPTEE_MSG_CMD_RUN_ASYNC lends the calling thread to secure world to
+ * execute the oldest queued asynchronous request. The request buffer is
+ * updated as for OPTEE_MSG_CMD_INVOKE_COMMAND and completion is reported
+ * as:
+ * [out] param[0].attr			OPTEE_MSG_ATTR_TYPE_VALUE_OUTPUT
+ * [out] param[0].u.value.a		id of the completed request
+ * [out] param[0].u.value.b		1 if more requests are queued, else 0
+ * struct optee_msg_arg::ret is TEEC_ERROR_NO_DATA if no request was
+ * queued.
+ *
+ * A queued request whose session is closed is completed with ret
+ * TEEC_ERROR_CANCEL without being executed, its id is reported by the
+ * next OPTEE_MSG_CMD_RUN_ASYNC. OPTEE_MSG_CMD_STOP_ASYNC_NOTIF completes
+ * all queued requests with TEEC_ERROR_CANCEL without reporting them.
+ * Unregistering shared memory completes the queued requests held in it
+ * the same way as when their session is closed.
  */
 #define OPTEE_MSG_CMD_OPEN_SESSION	U(0)
 #define OPTEE_MSG_CMD_INVOKE_COMMAND	U(1)
@@ -340,6 +388,9 @@ struct optee_msg_arg {
 #define OPTEE_MSG_CMD_UNREGISTER_SHM	U(5)
 #define OPTEE_MSG_CMD_DO_BOTTOM_HALF	U(6)
 #define OPTEE_MSG_CMD_STOP_ASYNC_NOTIF	U(7)
+#define OPTEE_MSG_CMD_INVOKE_BATCH	U(8)
+#define OPTEE_MSG_CMD_INVOKE_ASYNC	U(9)
+#define OPTEE_MSG_CMD_RUN_ASYNC		U(10)
 #define OPTEE_MSG_FUNCID_CALL_WITH_ARG	U(0x0004)
 
 #endif /* _OPTEE_MSG_H */
@@ -6,6 +6,7 @@
 #ifndef __TEE_TADB_H
 #define __TEE_TADB_H
 
+#include <signed_hdr.h>
 #include <tee/tee_fs.h>
 
 struct tee_tadb_ta_write;
@@ -26,6 +27,20 @@ struct tee_tadb_property {
 	uint32_t bin_size;
 };
 
+/* "COMP", identifies struct tee_tadb_compressed_custom */
+#define TEE_TADB_COMPRESSED_MAGIC	0x434f4d50
+
+/*
+ * struct tee_tadb_compressed_custom - custom properties of a TA stored
+ * compressed
+ * @magic:	TEE_TADB_COMPRESSED_MAGIC
+ * @chdr:	compression header of the installed SHDR_COMPRESSED_TA image
+ */
+struct tee_tadb_compressed_custom {
+	uint32_t magic;
+	struct shdr_compressed_ta chdr;
+};
+
 struct tee_fs_rpc_operation;
 
 struct tee_tadb_file_operations {
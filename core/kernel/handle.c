@@ -26,55 +26,69 @@ void handle_db_destroy(struct handle_db *db, void (*ptr_destructor)(void *ptr))
 					ptr_destructor(db->ptrs[n]);
 		}
 		free(db->ptrs);
+		free(db->free_idx);
 		db->ptrs = NULL;
+		db->free_idx = NULL;
+		db->num_free = 0;
 		db->max_ptrs = 0;
 	}
 }
 
 bool handle_db_is_empty(struct handle_db *db)
 {
-	size_t n = 0;
-
-	if (db) {
-		for (n = 0; n < db->max_ptrs; n++) {
-			if (db->ptrs[n])
-				return false;
-		}
-	}
-	return true;
+	return !db || db->num_free == db->max_ptrs;
 }
 
-int handle_get(struct handle_db *db, void *ptr)
+static bool grow_db(struct handle_db *db)
 {
-	size_t n;
-	void *p;
-	size_t new_max_ptrs;
-
-	if (!db || !ptr)
-		return -1;
-
-	/* Try to find an empty location */
-	for (n = 0; n < db->max_ptrs; n++) {
-		if (!db->ptrs[n]) {
-			db->ptrs[n] = ptr;
-			return n;
-		}
-	}
+	size_t new_max_ptrs = 0;
+	size_t n = 0;
+	void *p = NULL;
 
-	/* No location available, grow the ptrs array */
 	if (db->max_ptrs)
 		new_max_ptrs = db->max_ptrs * 2;
 	else
 		new_max_ptrs = HANDLE_DB_INITIAL_MAX_PTRS;
+	if (new_max_ptrs > INT32_MAX)
+		return false;
+
 	p = realloc(db->ptrs, new_max_ptrs * sizeof(void *));
 	if (!p)
-		return -1;
+		return false;
 	db->ptrs = p;
 	memset(db->ptrs + db->max_ptrs, 0,
 	       (new_max_ptrs - db->max_ptrs) * sizeof(void *));
+
+	/*
+	 * If this fails the ptrs array above is just larger than needed,
+	 * max_ptrs is only updated once both arrays are large enough.
+	 */
+	p = realloc(db->free_idx, new_max_ptrs * sizeof(int));
+	if (!p)
+		return false;
+	db->free_idx = p;
+
+	/* Push the new handles so that the lowest is popped first */
+	for (n = new_max_ptrs; n > db->max_ptrs; n--)
+		db->free_idx[db->num_free++] = n - 1;
 	db->max_ptrs = new_max_ptrs;
 
-	/* Since n stopped at db->max_ptrs there is an empty location there */
+	return true;
+}
+
+int handle_get(struct handle_db *db, void *ptr)
+{
+	int n = 0;
+
+	if (!db || !ptr)
+		return -1;
+
+	/* If there's no empty location available, grow the database */
+	if (!db->num_free && !grow_db(db))
+		return -1;
+
+	db->num_free--;
+	n = db->free_idx[db->num_free];
 	db->ptrs[n] = ptr;
 	return n;
 }
@@ -87,7 +101,11 @@ void *handle_put(struct handle_db *db, int handle)
 		return NULL;
 
 	p = db->ptrs[handle];
-	db->ptrs[handle] = NULL;
+	if (p) {
+		db->ptrs[handle] = NULL;
+		db->free_idx[db->num_free] = handle;
+		db->num_free++;
+	}
 	return p;
 }
 
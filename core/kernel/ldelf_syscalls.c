@@ -5,8 +5,11 @@
  */
 
 #include <assert.h>
+#include <atomic.h>
 #include <crypto/crypto.h>
 #include <kernel/ldelf_syscalls.h>
+#include <kernel/ree_fs_ta.h>
+#include <kernel/tee_ta_manager.h>
 #include <kernel/user_mode_ctx.h>
 #include <ldelf.h>
 #include <mm/file.h>
@@ -24,8 +27,30 @@ struct bin_handle {
 	struct file *f;
 	size_t offs_bytes;
 	size_t size_bytes;
+	uint32_t id;
 };
 
+/* Source of bin_handle::id, identifying the slices added via a handle */
+static uint32_t bin_handle_next_id;
+
+struct fobj *ldelf_ta_mem_alloc(unsigned int num_pages)
+{
+	struct fobj *f = fobj_ta_mem_alloc(num_pages);
+
+	if (!f) {
+		/*
+		 * Cached read-only segments and TA images or idle TA
+		 * instances may be what's filling up TA RAM
+		 */
+		file_cache_drop_unused();
+		ree_fs_ta_cache_drop_unused();
+		tee_ta_idle_pool_flush();
+		f = fobj_ta_mem_alloc(num_pages);
+	}
+
+	return f;
+}
+
 TEE_Result ldelf_syscall_map_zi(vaddr_t *va, size_t num_bytes, size_t pad_begin,
 				size_t pad_end, unsigned long flags)
 {
@@ -43,7 +68,7 @@ TEE_Result ldelf_syscall_map_zi(vaddr_t *va, size_t num_bytes, size_t pad_begin,
 	if (flags & LDELF_MAP_FLAG_SHAREABLE)
 		vm_flags |= VM_FLAG_SHAREABLE;
 
-	f = fobj_ta_mem_alloc(ROUNDUP_DIV(num_bytes, SMALL_PAGE_SIZE));
+	f = ldelf_ta_mem_alloc(ROUNDUP_DIV(num_bytes, SMALL_PAGE_SIZE));
 	if (!f)
 		return TEE_ERROR_OUT_OF_MEMORY;
 	mobj = mobj_with_fobj_alloc(f, NULL);
@@ -135,6 +160,7 @@ TEE_Result ldelf_syscall_open_bin(const TEE_UUID *uuid, size_t uuid_size,
 	binh = calloc(1, sizeof(*binh));
 	if (!binh)
 		return TEE_ERROR_OUT_OF_MEMORY;
+	binh->id = atomic_inc32(&bin_handle_next_id);
 
 	if (is_user_ta_ctx(sess->ctx) || is_stmm_ctx(sess->ctx)) {
 		SCATTERED_ARRAY_FOREACH(binh->op, ta_stores,
@@ -191,6 +217,22 @@ err:
 	return res;
 }
 
+static void binh_lock_file(struct user_mode_ctx *uctx,
+			   struct bin_handle *binh)
+{
+	if (!file_trylock(binh->f)) {
+		/*
+		 * Before we can block on the file lock we must make all
+		 * our page tables available for reclaiming in order to
+		 * avoid a dead-lock with the other thread (which already
+		 * is holding the file lock) mapping lots of memory.
+		 */
+		vm_set_ctx(NULL);
+		file_lock(binh->f);
+		vm_set_ctx(uctx->ts_ctx);
+	}
+}
+
 TEE_Result ldelf_syscall_close_bin(unsigned long handle)
 {
 	TEE_Result res = TEE_SUCCESS;
@@ -209,6 +251,17 @@ TEE_Result ldelf_syscall_close_bin(unsigned long handle)
 		res = binh->op->read(binh->h, NULL,
 				     binh->size_bytes - binh->offs_bytes);
 
+	/*
+	 * The binary is now completely read and verified. If all the
+	 * slices were populated by this handle they can be kept for later
+	 * instances.
+	 */
+	if (!res) {
+		binh_lock_file(to_user_mode_ctx(sess->ctx), binh);
+		file_set_verified(binh->f, binh->id);
+		file_unlock(binh->f);
+	}
+
 	bin_close(binh);
 	if (handle_db_is_empty(&sys_ctx->db)) {
 		handle_db_destroy(&sys_ctx->db, bin_close);
@@ -313,17 +366,7 @@ TEE_Result ldelf_syscall_map_bin(vaddr_t *va, size_t num_bytes,
 		return TEE_ERROR_BAD_PARAMETERS;
 	num_pages = num_rounded_bytes / SMALL_PAGE_SIZE;
 
-	if (!file_trylock(binh->f)) {
-		/*
-		 * Before we can block on the file lock we must make all
-		 * our page tables available for reclaiming in order to
-		 * avoid a dead-lock with the other thread (which already
-		 * is holding the file lock) mapping lots of memory below.
-		 */
-		vm_set_ctx(NULL);
-		file_lock(binh->f);
-		vm_set_ctx(uctx->ts_ctx);
-	}
+	binh_lock_file(uctx, binh);
 	file_is_locked = true;
 	fs = file_find_slice(binh->f, offs_pages);
 	if (fs) {
@@ -352,7 +395,7 @@ TEE_Result ldelf_syscall_map_bin(vaddr_t *va, size_t num_bytes,
 		if (res)
 			goto err;
 	} else {
-		struct fobj *f = fobj_ta_mem_alloc(num_pages);
+		struct fobj *f = ldelf_ta_mem_alloc(num_pages);
 		struct file *file = NULL;
 		uint32_t vm_flags = 0;
 
@@ -392,7 +435,15 @@ TEE_Result ldelf_syscall_map_bin(vaddr_t *va, size_t num_bytes,
 		vm_set_ctx(uctx->ts_ctx);
 
 		if (!(flags & LDELF_MAP_FLAG_WRITEABLE)) {
-			res = file_add_slice(binh->f, f, offs_pages);
+			res = file_add_slice(binh->f, f, offs_pages,
+					     binh->id);
+			/*
+			 * The data isn't verified yet and a cached file
+			 * must only be shared from verified data, keep
+			 * this mapping private instead.
+			 */
+			if (res == TEE_ERROR_BAD_STATE)
+				res = TEE_SUCCESS;
 			if (res)
 				goto err_unmap_va;
 		}
@@ -18,6 +18,8 @@
 #define LOCKDEP_NODE_PERM_MARK		BIT(1)
 /* Flag used during breadth-first search (print shortest cycle) */
 #define LOCKDEP_NODE_BFS_VISITED	BIT(2)
+/* Flag used when printing the profile */
+#define LOCKDEP_NODE_PRINTED		BIT(3)
 
 /* Find node in graph or add it */
 static struct lockdep_node *lockdep_add_to_graph(
@@ -417,6 +419,149 @@ TEE_Result __lockdep_lock_release(struct lockdep_lock_head *owned, uintptr_t id)
 	return TEE_ERROR_ITEM_NOT_FOUND;
 }
 
+static struct lockdep_lock *lockdep_find_owned(struct lockdep_lock_head *owned,
+					       uintptr_t id)
+{
+	struct lockdep_lock *lock = NULL;
+
+	TAILQ_FOREACH_REVERSE(lock, owned, lockdep_lock_head, link)
+		if (lock->node->lock_id == id)
+			return lock;
+
+	return NULL;
+}
+
+/*
+ * Keeps the call sites most often found waiting, when the table is full
+ * the least frequent site is replaced and inherits its count so that a
+ * new hot site can climb the table.
+ */
+static void lockdep_profile_add_site(struct lockdep_profile *p, vaddr_t site)
+{
+	struct lockdep_call_site *min = p->sites;
+	size_t n = 0;
+
+	for (n = 0; n < ARRAY_SIZE(p->sites); n++) {
+		if (p->sites[n].addr == site) {
+			p->sites[n].count++;
+			return;
+		}
+		if (p->sites[n].count < min->count)
+			min = p->sites + n;
+	}
+
+	min->addr = site;
+	min->count++;
+}
+
+void lockdep_lock_profile_acquired(struct lockdep_lock_head *owned,
+				   uintptr_t id, uint64_t now,
+				   uint64_t wait_ticks, bool contended,
+				   vaddr_t site)
+{
+	struct lockdep_lock *lock = lockdep_find_owned(owned, id);
+	struct lockdep_profile *p = NULL;
+
+	if (!lock)
+		return;
+
+	lock->acquired_at = now;
+	p = &lock->node->profile;
+	p->acquired++;
+	if (contended) {
+		p->contended++;
+		p->wait_ticks += wait_ticks;
+		lockdep_profile_add_site(p, site);
+	}
+}
+
+void lockdep_lock_profile_release(struct lockdep_lock_head *owned,
+				  uintptr_t id, uint64_t now)
+{
+	struct lockdep_lock *lock = lockdep_find_owned(owned, id);
+
+	if (lock && lock->acquired_at)
+		lock->node->profile.hold_ticks += now - lock->acquired_at;
+}
+
+static struct lockdep_node *
+lockdep_next_profile_node(struct lockdep_node_head *graph)
+{
+	struct lockdep_node *node = NULL;
+	struct lockdep_node *max = NULL;
+
+	TAILQ_FOREACH(node, graph, link) {
+		if ((node->flags & LOCKDEP_NODE_PRINTED) ||
+		    !node->profile.acquired)
+			continue;
+		if (!max || node->profile.wait_ticks > max->profile.wait_ticks)
+			max = node;
+	}
+
+	return max;
+}
+
+size_t lockdep_graph_count_profiles(struct lockdep_node_head *graph)
+{
+	struct lockdep_node *node = NULL;
+	size_t count = 0;
+
+	TAILQ_FOREACH(node, graph, link)
+		if (node->profile.acquired)
+			count++;
+
+	return count;
+}
+
+size_t lockdep_graph_get_profile(struct lockdep_node_head *graph,
+				 struct lockdep_profile_entry *entries,
+				 size_t max_entries, bool reset)
+{
+	struct lockdep_node *node = NULL;
+	size_t count = 0;
+
+	while (count < max_entries) {
+		node = lockdep_next_profile_node(graph);
+		if (!node)
+			break;
+		node->flags |= LOCKDEP_NODE_PRINTED;
+		entries[count].lock_id = node->lock_id;
+		entries[count].profile = node->profile;
+		count++;
+	}
+
+	TAILQ_FOREACH(node, graph, link) {
+		node->flags &= ~LOCKDEP_NODE_PRINTED;
+		if (reset)
+			node->profile = (struct lockdep_profile){ };
+	}
+
+	return count;
+}
+
+void lockdep_print_profile(struct lockdep_profile_entry *entries,
+			   size_t count)
+{
+	size_t m = 0;
+	size_t n = 0;
+
+	IMSG("lockdep profile: lock acquired contended wait hold (ticks)");
+	for (m = 0; m < count; m++) {
+		struct lockdep_profile *p = &entries[m].profile;
+
+		IMSG("%#" PRIxPTR " %" PRIu32 " %" PRIu32 " %" PRIu64
+		     " %" PRIu64, entries[m].lock_id, p->acquired,
+		     p->contended, p->wait_ticks, p->hold_ticks);
+		for (n = 0; n < ARRAY_SIZE(p->sites); n++) {
+			struct lockdep_call_site *site = p->sites + n;
+
+			if (site->count)
+				IMSG("  waited at %#" PRIxVA " %" PRIu32
+				     " times", site->addr, site->count);
+		}
+	}
+}
+
 static void lockdep_free_edge(struct lockdep_edge *edge)
 {
 	free(edge->call_stack_from);
@@ -3,6 +3,7 @@
  * Copyright (c) 2015-2017, Linaro Limited
  */
 
+#include <atomic.h>
 #include <kernel/mutex.h>
 #include <kernel/panic.h>
 #include <kernel/refcount.h>
@@ -12,6 +13,9 @@
 
 #include "mutex_lockdep.h"
 
+/* Call site of the public lock functions, recorded by the lock profiler */
+#define CALLER_ADDR	((vaddr_t)__builtin_return_address(0))
+
 void mutex_init(struct mutex *m)
 {
 	*m = (struct mutex)MUTEX_INITIALIZER;
@@ -22,8 +26,95 @@ void mutex_init_recursive(struct recursive_mutex *m)
 	*m = (struct recursive_mutex)RECURSIVE_MUTEX_INITIALIZER;
 }
 
-static void __mutex_lock(struct mutex *m, const char *fname, int lineno)
+#if CFG_MUTEX_SPIN_BUDGET
+static struct mutex_spin_stats spin_stats;
+
+/*
+ * Called with m->spin_lock held. Returns true if it's worth polling the
+ * mutex for a while instead of going to sleep in normal world, that is,
+ * the mutex is write locked by a thread currently executing on another
+ * core.
+ */
+static bool owner_is_running(struct mutex *m)
+{
+	return m->state == -1 && m->owner != thread_get_id() &&
+	       thread_is_active(m->owner);
+}
+
+/*
+ * Polls the mutex without holding m->spin_lock until it's available for
+ * the requested kind of lock, the owner changes or stops executing, or the
+ * budget is exhausted. The caller has to retry taking the mutex
+ * regardless of the outcome.
+ */
+static void spin_on_owner(struct mutex *m, bool read)
+{
+	short int owner = atomic_load_short(&m->owner);
+	unsigned int n = 0;
+
+	atomic_inc32(&spin_stats.spins);
+
+	for (n = 0; n < CFG_MUTEX_SPIN_BUDGET; n++) {
+		short int state = atomic_load_short(&m->state);
+
+		if (read ? state != -1 : !state)
+			return;
+		if (atomic_load_short(&m->owner) != owner ||
+		    !thread_is_active(owner))
+			return;
+		/* Let a sibling hardware thread make progress */
+		yield();
+	}
+}
+
+static void spin_acquired(void)
+{
+	atomic_inc32(&spin_stats.spin_acquired);
+}
+
+static void sleep_accounted(void)
+{
+	atomic_inc32(&spin_stats.sleeps);
+}
+
+void mutex_get_spin_stats(struct mutex_spin_stats *stats, bool reset)
+{
+	stats->spins = atomic_load_u32(&spin_stats.spins);
+	stats->spin_acquired = atomic_load_u32(&spin_stats.spin_acquired);
+	stats->sleeps = atomic_load_u32(&spin_stats.sleeps);
+
+	if (reset) {
+		atomic_store_u32(&spin_stats.spins, 0);
+		atomic_store_u32(&spin_stats.spin_acquired, 0);
+		atomic_store_u32(&spin_stats.sleeps, 0);
+	}
+}
+#else
+static bool owner_is_running(struct mutex *m __unused)
+{
+	return false;
+}
+
+static void spin_on_owner(struct mutex *m __unused, bool read __unused)
+{
+}
+
+static void spin_acquired(void)
+{
+}
+
+static void sleep_accounted(void)
+{
+}
+#endif
+
+static void __mutex_lock(struct mutex *m, vaddr_t caller, const char *fname,
+			 int lineno)
 {
+	uint64_t start = mutex_lock_profile_start();
+	bool contended = false;
+	bool spun = false;
+
 	assert_have_no_spinlock();
 	assert(thread_get_id_may_fail() != THREAD_ID_INVALID);
 	assert(thread_is_in_normal_mode());
@@ -33,12 +124,14 @@ static void __mutex_lock(struct mutex *m, const char *fname, int lineno)
 	while (true) {
 		uint32_t old_itr_status;
 		bool can_lock;
+		bool spin = false;
 		struct wait_queue_elem wqe;
 
 		/*
 		 * If the mutex is locked we need to initialize the wqe
 		 * before releasing the spinlock to guarantee that we don't
-		 * miss the wakeup from mutex_unlock().
+		 * miss the wakeup from mutex_unlock(), unless we're going
+		 * to spin and retry instead.
 		 *
 		 * If the mutex is unlocked we don't need to use the wqe at
 		 * all.
@@ -48,26 +141,47 @@ static void __mutex_lock(struct mutex *m, const char *fname, int lineno)
 
 		can_lock = !m->state;
 		if (!can_lock) {
-			wq_wait_init(&m->wq, &wqe, false /* wait_read */);
+			contended = true;
+			spin = !spun && owner_is_running(m);
+			if (!spin)
+				wq_wait_init(&m->wq, &wqe,
+					     false /* wait_read */);
 		} else {
 			m->state = -1; /* write locked */
+			m->owner = thread_get_id();
 		}
 
 		cpu_spin_unlock_xrestore(&m->spin_lock, old_itr_status);
 
-		if (!can_lock) {
+		if (can_lock) {
+			if (spun)
+				spin_acquired();
+			mutex_lock_profile(m, start, contended, caller);
+			return;
+		}
+
+		if (spin) {
+			/*
+			 * The owner is running on another core and is
+			 * likely to release the lock soon, poll for a
+			 * while before taking the expensive path.
+			 */
+			spin_on_owner(m, false /* read */);
+			spun = true;
+		} else {
 			/*
 			 * Someone else is holding the lock, wait in normal
 			 * world for the lock to become available.
 			 */
+			sleep_accounted();
 			wq_wait_final(&m->wq, &wqe, m, fname, lineno);
-		} else
-			return;
+			spun = false;
+		}
 	}
 }
 
-static void __mutex_lock_recursive(struct recursive_mutex *m, const char *fname,
-				   int lineno)
+static void __mutex_lock_recursive(struct recursive_mutex *m, vaddr_t caller,
+				   const char *fname, int lineno)
 {
 	short int ct = thread_get_id();
 
@@ -80,7 +194,7 @@ static void __mutex_lock_recursive(struct recursive_mutex *m, const char *fname,
 		return;
 	}
 
-	__mutex_lock(&m->m, fname, lineno);
+	__mutex_lock(&m->m, caller, fname, lineno);
 
 	assert(m->owner == THREAD_ID_INVALID);
 	atomic_store_short(&m->owner, ct);
@@ -102,6 +216,7 @@ static void __mutex_unlock(struct mutex *m, const char *fname, int lineno)
 		panic();
 
 	m->state = 0;
+	m->owner = THREAD_ID_INVALID;
 
 	cpu_spin_unlock_xrestore(&m->spin_lock, old_itr_status);
 
@@ -124,8 +239,8 @@ static void __mutex_unlock_recursive(struct recursive_mutex *m,
 	}
 }
 
-static bool __mutex_trylock(struct mutex *m, const char *fname __unused,
-			int lineno __unused)
+static bool __mutex_trylock(struct mutex *m, vaddr_t caller,
+			    const char *fname __unused, int lineno __unused)
 {
 	uint32_t old_itr_status;
 	bool can_lock_write;
@@ -136,13 +251,18 @@ static bool __mutex_trylock(struct mutex *m, const char *fname __unused,
 	old_itr_status = cpu_spin_lock_xsave(&m->spin_lock);
 
 	can_lock_write = !m->state;
-	if (can_lock_write)
+	if (can_lock_write) {
 		m->state = -1;
+		m->owner = thread_get_id();
+	}
 
 	cpu_spin_unlock_xrestore(&m->spin_lock, old_itr_status);
 
-	if (can_lock_write)
+	if (can_lock_write) {
 		mutex_trylock_check(m);
+		mutex_lock_profile(m, mutex_lock_profile_start(),
+				   false /* contended */, caller);
+	}
 
 	return can_lock_write;
 }
@@ -171,6 +291,8 @@ static void __mutex_read_unlock(struct mutex *m, const char *fname, int lineno)
 
 static void __mutex_read_lock(struct mutex *m, const char *fname, int lineno)
 {
+	bool spun = false;
+
 	assert_have_no_spinlock();
 	assert(thread_get_id_may_fail() != THREAD_ID_INVALID);
 	assert(thread_is_in_normal_mode());
@@ -178,12 +300,14 @@ static void __mutex_read_lock(struct mutex *m, const char *fname, int lineno)
 	while (true) {
 		uint32_t old_itr_status;
 		bool can_lock;
+		bool spin = false;
 		struct wait_queue_elem wqe;
 
 		/*
 		 * If the mutex is locked we need to initialize the wqe
 		 * before releasing the spinlock to guarantee that we don't
-		 * miss the wakeup from mutex_unlock().
+		 * miss the wakeup from mutex_unlock(), unless we're going
+		 * to spin and retry instead.
 		 *
 		 * If the mutex is unlocked we don't need to use the wqe at
 		 * all.
@@ -193,21 +317,34 @@ static void __mutex_read_lock(struct mutex *m, const char *fname, int lineno)
 
 		can_lock = m->state != -1;
 		if (!can_lock) {
-			wq_wait_init(&m->wq, &wqe, true /* wait_read */);
+			spin = !spun && owner_is_running(m);
+			if (!spin)
+				wq_wait_init(&m->wq, &wqe,
+					     true /* wait_read */);
 		} else {
 			m->state++; /* read_locked */
 		}
 
 		cpu_spin_unlock_xrestore(&m->spin_lock, old_itr_status);
 
-		if (!can_lock) {
+		if (can_lock) {
+			if (spun)
+				spin_acquired();
+			return;
+		}
+
+		if (spin) {
+			spin_on_owner(m, true /* read */);
+			spun = true;
+		} else {
 			/*
 			 * Someone else is holding the lock, wait in normal
 			 * world for the lock to become available.
 			 */
+			sleep_accounted();
 			wq_wait_final(&m->wq, &wqe, m, fname, lineno);
-		} else
-			return;
+			spun = false;
+		}
 	}
 }
 
@@ -240,12 +377,12 @@ void mutex_unlock_debug(struct mutex *m, const char *fname, int lineno)
 
 void mutex_lock_debug(struct mutex *m, const char *fname, int lineno)
 {
-	__mutex_lock(m, fname, lineno);
+	__mutex_lock(m, CALLER_ADDR, fname, lineno);
 }
 
 bool mutex_trylock_debug(struct mutex *m, const char *fname, int lineno)
 {
-	return __mutex_trylock(m, fname, lineno);
+	return __mutex_trylock(m, CALLER_ADDR, fname, lineno);
 }
 
 void mutex_read_unlock_debug(struct mutex *m, const char *fname, int lineno)
@@ -272,7 +409,7 @@ void mutex_unlock_recursive_debug(struct recursive_mutex *m, const char *fname,
 void mutex_lock_recursive_debug(struct recursive_mutex *m, const char *fname,
 				int lineno)
 {
-	__mutex_lock_recursive(m, fname, lineno);
+	__mutex_lock_recursive(m, CALLER_ADDR, fname, lineno);
 }
 #else
 void mutex_unlock(struct mutex *m)
@@ -287,17 +424,17 @@ void mutex_unlock_recursive(struct recursive_mutex *m)
 
 void mutex_lock(struct mutex *m)
 {
-	__mutex_lock(m, NULL, -1);
+	__mutex_lock(m, CALLER_ADDR, NULL, -1);
 }
 
 void mutex_lock_recursive(struct recursive_mutex *m)
 {
-	__mutex_lock_recursive(m, NULL, -1);
+	__mutex_lock_recursive(m, CALLER_ADDR, NULL, -1);
 }
 
 bool mutex_trylock(struct mutex *m)
 {
-	return __mutex_trylock(m, NULL, -1);
+	return __mutex_trylock(m, CALLER_ADDR, NULL, -1);
 }
 
 void mutex_read_unlock(struct mutex *m)
@@ -425,6 +562,7 @@ static void __condvar_wait(struct condvar *cv, struct mutex *m,
 	} else {
 		/* Only one lock (read or write), unlock the mutex */
 		m->state = 0;
+		m->owner = THREAD_ID_INVALID;
 	}
 	new_state = m->state;
 
@@ -3,10 +3,13 @@
  * Copyright (c) 2018, Linaro Limited
  */
 
+#include <arm.h>
 #include <assert.h>
+#include <config.h>
 #include <kernel/lockdep.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
+#include <stdlib.h>
 #include <sys/queue.h>
 #include <trace.h>
 
@@ -60,6 +63,9 @@ void mutex_unlock_check(struct mutex *m)
 	uint32_t exceptions = 0;
 
 	exceptions = cpu_spin_lock_xsave(&graph_lock);
+	if (IS_ENABLED(CFG_LOCKDEP_PROFILE))
+		lockdep_lock_profile_release(&owned[thread], (uintptr_t)m,
+					     barrier_read_counter_timer());
 	lockdep_lock_release(&owned[thread], (uintptr_t)m);
 	cpu_spin_unlock_xrestore(&graph_lock, exceptions);
 }
@@ -71,3 +77,49 @@ void mutex_destroy_check(struct mutex *m)
 	lockdep_lock_destroy(&graph, (uintptr_t)m);
 	cpu_spin_unlock_xrestore(&graph_lock, exceptions);
 }
+
+#ifdef CFG_LOCKDEP_PROFILE
+void mutex_lock_profile(struct mutex *m, uint64_t start, bool contended,
+			vaddr_t caller)
+{
+	short int thread = thread_get_id();
+	uint64_t now = barrier_read_counter_timer();
+	uint32_t exceptions = 0;
+
+	exceptions = cpu_spin_lock_xsave(&graph_lock);
+	lockdep_lock_profile_acquired(&owned[thread], (uintptr_t)m, now,
+				      now - start, contended, caller);
+	cpu_spin_unlock_xrestore(&graph_lock, exceptions);
+}
+#endif
+
+void mutex_lockdep_print_profile(bool reset)
+{
+	struct lockdep_profile_entry *entries = NULL;
+	uint32_t exceptions = 0;
+	size_t count = 0;
+
+	/*
+	 * Printing is far too slow to be done with exceptions masked, the
+	 * profiles are copied under the lock and printed once released.
+	 * Locks first acquired in between are left for the next call.
+	 */
+	exceptions = cpu_spin_lock_xsave(&graph_lock);
+	count = lockdep_graph_count_profiles(&graph);
+	cpu_spin_unlock_xrestore(&graph_lock, exceptions);
+
+	if (count) {
+		entries = calloc(count, sizeof(*entries));
+		if (!entries) {
+			EMSG("Out of memory for %zu lock profiles", count);
+			return;
+		}
+	}
+
+	exceptions = cpu_spin_lock_xsave(&graph_lock);
+	count = lockdep_graph_get_profile(&graph, entries, count, reset);
+	cpu_spin_unlock_xrestore(&graph_lock, exceptions);
+
+	lockdep_print_profile(entries, count);
+	free(entries);
+}
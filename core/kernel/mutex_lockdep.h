@@ -5,6 +5,7 @@
 #ifndef MUTEX_LOCKDEP_H
 #define MUTEX_LOCKDEP_H
 
+#include <arm.h>
 #include <compiler.h>
 #include <kernel/mutex.h>
 
@@ -34,4 +35,33 @@ static inline void mutex_destroy_check(struct mutex *m __unused)
 
 #endif /* !CFG_LOCKDEP */
 
+#ifdef CFG_LOCKDEP_PROFILE
+
+static inline uint64_t mutex_lock_profile_start(void)
+{
+	return barrier_read_counter_timer();
+}
+
+/*
+ * Called when @m has been acquired by @caller which started trying at
+ * @start, @contended tells if @caller found the mutex held.
+ */
+void mutex_lock_profile(struct mutex *m, uint64_t start, bool contended,
+			vaddr_t caller);
+
+#else
+
+static inline uint64_t mutex_lock_profile_start(void)
+{
+	return 0;
+}
+
+static inline void mutex_lock_profile(struct mutex *m __unused,
+				      uint64_t start __unused,
+				      bool contended __unused,
+				      vaddr_t caller __unused)
+{}
+
+#endif /* !CFG_LOCKDEP_PROFILE */
+
 #endif /* MUTEX_LOCKDEP_H */
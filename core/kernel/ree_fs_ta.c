@@ -36,8 +36,11 @@
  */
 
 #include <assert.h>
+#include <config.h>
 #include <crypto/crypto.h>
 #include <initcall.h>
+#include <kernel/ree_fs_ta.h>
+#include <kernel/ta_inflate.h>
 #include <kernel/thread.h>
 #include <kernel/ts_store.h>
 #include <mm/core_memprot.h>
@@ -65,8 +68,17 @@ struct ree_fs_ta_handle {
 	void *enc_ctx;
 	struct shdr_bootstrap_ta *bs_hdr;
 	struct shdr_encrypted_ta *ehdr;
+	uint8_t *bounce; /* Destination of skipped encrypted data */
+	struct ta_inflate *inflate; /* Only for SHDR_COMPRESSED_TA */
+	size_t uncompressed_size;
 };
 
+/*
+ * Size of the pieces the TA binary is copied or decrypted and hashed in,
+ * small enough for a piece to stay in the data cache in between.
+ */
+#define REE_FS_TA_CHUNK_SIZE	(8 * 1024U)
+
 struct ta_ver_db_hdr {
 	uint32_t db_version;
 	uint32_t nb_entries;
@@ -124,6 +136,24 @@ exit:
 	return res;
 }
 
+/*
+ * Supplies the compressed binary of a SHDR_COMPRESSED_TA image to
+ * ta_inflate_read(), the data is hashed once copied to secure memory.
+ */
+static TEE_Result ree_fs_ta_fill(void *ctx, uint8_t *buf, size_t *len)
+{
+	struct ree_fs_ta_handle *handle = ctx;
+	size_t l = MIN(*len, handle->nw_ta_size - handle->offs);
+
+	memcpy(buf, (uint8_t *)handle->nw_ta + handle->offs, l);
+	if (crypto_hash_update(handle->hash_ctx, buf, l))
+		return TEE_ERROR_SECURITY;
+
+	handle->offs += l;
+	*len = l;
+	return TEE_SUCCESS;
+}
+
 static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
 				 struct ts_store_handle **h)
 {
@@ -160,7 +190,9 @@ static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
 	if (res != TEE_SUCCESS)
 		goto error_free_payload;
 	if (shdr->img_type != SHDR_TA && shdr->img_type != SHDR_BOOTSTRAP_TA &&
-	    shdr->img_type != SHDR_ENCRYPTED_TA) {
+	    shdr->img_type != SHDR_ENCRYPTED_TA &&
+	    (shdr->img_type != SHDR_COMPRESSED_TA ||
+	     !IS_ENABLED(CFG_TA_COMPRESSED_IMAGES))) {
 		res = TEE_ERROR_SECURITY;
 		goto error_free_payload;
 	}
@@ -187,7 +219,8 @@ static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
 	offs = shdr_sz;
 
 	if (shdr->img_type == SHDR_BOOTSTRAP_TA ||
-	    shdr->img_type == SHDR_ENCRYPTED_TA) {
+	    shdr->img_type == SHDR_ENCRYPTED_TA ||
+	    shdr->img_type == SHDR_COMPRESSED_TA) {
 		TEE_UUID bs_uuid = { };
 		size_t sz = shdr_sz;
 
@@ -267,6 +300,31 @@ static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
 		handle->ehdr = ehdr;
 	}
 
+	if (shdr->img_type == SHDR_COMPRESSED_TA) {
+		struct shdr_compressed_ta chdr = { };
+		size_t sz = offs;
+
+		if (ADD_OVERFLOW(sz, sizeof(chdr), &sz) || ta_size < sz) {
+			res = TEE_ERROR_SECURITY;
+			goto error_free_hash;
+		}
+
+		memcpy(&chdr, (uint8_t *)ta + offs, sizeof(chdr));
+		res = crypto_hash_update(hash_ctx, (uint8_t *)&chdr,
+					 sizeof(chdr));
+		if (res != TEE_SUCCESS)
+			goto error_free_hash;
+
+		res = ta_inflate_alloc(chdr.comp_algo, chdr.uncompressed_size,
+				       ree_fs_ta_fill, handle,
+				       &handle->inflate);
+		if (res != TEE_SUCCESS)
+			goto error_free_hash;
+
+		offs += sizeof(chdr);
+		handle->uncompressed_size = chdr.uncompressed_size;
+	}
+
 	if (ta_size != offs + shdr->img_size) {
 		res = TEE_ERROR_SECURITY;
 		goto error_free_hash;
@@ -286,6 +344,7 @@ error_free_hash:
 error_free_payload:
 	thread_rpc_free_payload(mobj);
 error:
+	ta_inflate_free(handle->inflate);
 	free(ehdr);
 	free(bs_hdr);
 	shdr_free(shdr);
@@ -298,7 +357,10 @@ static TEE_Result ree_fs_ta_get_size(const struct ts_store_handle *h,
 {
 	struct ree_fs_ta_handle *handle = (struct ree_fs_ta_handle *)h;
 
-	*size = handle->shdr->img_size;
+	if (handle->inflate)
+		*size = handle->uncompressed_size;
+	else
+		*size = handle->shdr->img_size;
 	return TEE_SUCCESS;
 }
 
@@ -406,11 +468,17 @@ static TEE_Result check_update_version(struct shdr_bootstrap_ta *hdr)
 			res = TEE_ERROR_ACCESS_CONFLICT;
 			goto out;
 		} else if (hdr_entry.ta_version < hdr->ta_version) {
+			TEE_UUID uuid = { };
+
 			len = sizeof(*hdr);
 			res = ops->write(fh, sizeof(db_hdr) + (i * len), hdr,
 					 len);
 			if (res != TEE_SUCCESS)
 				goto out;
+
+			/* A cached image may now be rolled back */
+			tee_uuid_from_octets(&uuid, hdr->uuid);
+			ree_fs_ta_cache_invalidate(&uuid);
 		}
 	} else {
 		len = sizeof(*hdr);
@@ -431,6 +499,32 @@ out:
 	return res;
 }
 
+/*
+ * Copies or decrypts @len bytes from shared memory into @dst and hashes
+ * them. The caller passes at most REE_FS_TA_CHUNK_SIZE bytes at a time so
+ * the hash reads back what was just written while it's still in the cache.
+ */
+static TEE_Result read_chunk(struct ree_fs_ta_handle *handle, uint8_t *dst,
+			     uint8_t *src, size_t len)
+{
+	TEE_Result res = TEE_SUCCESS;
+
+	if (handle->shdr->img_type == SHDR_ENCRYPTED_TA) {
+		res = tee_ta_decrypt_update(handle->enc_ctx, dst, src, len);
+		if (res != TEE_SUCCESS)
+			return TEE_ERROR_SECURITY;
+	} else {
+		/* Hash secure buffer (shm might be modified) */
+		memcpy(dst, src, len);
+	}
+
+	res = crypto_hash_update(handle->hash_ctx, dst, len);
+	if (res != TEE_SUCCESS)
+		return TEE_ERROR_SECURITY;
+
+	return TEE_SUCCESS;
+}
+
 static TEE_Result ree_fs_ta_read(struct ts_store_handle *h, void *data,
 				 size_t len)
 {
@@ -438,60 +532,52 @@ static TEE_Result ree_fs_ta_read(struct ts_store_handle *h, void *data,
 
 	uint8_t *src = (uint8_t *)handle->nw_ta + handle->offs;
 	size_t next_offs = 0;
-	uint8_t *dst = src;
+	size_t num_bytes = 0;
 	TEE_Result res = TEE_SUCCESS;
 
+	if (handle->inflate) {
+		res = ta_inflate_read(handle->inflate, data, len);
+		if (res != TEE_SUCCESS)
+			return res;
+		if (!ta_inflate_done(handle->inflate))
+			return TEE_SUCCESS;
+		/* All compressed data has been hashed */
+		assert(handle->offs == handle->nw_ta_size);
+		goto out;
+	}
+
 	if (ADD_OVERFLOW(handle->offs, len, &next_offs) ||
 	    next_offs > handle->nw_ta_size)
 		return TEE_ERROR_BAD_PARAMETERS;
 
-	if (handle->shdr->img_type == SHDR_ENCRYPTED_TA) {
-		if (data) {
-			dst = data; /* Hash secure buffer */
-			res = tee_ta_decrypt_update(handle->enc_ctx, dst, src,
-						    len);
-			if (res != TEE_SUCCESS)
-				return TEE_ERROR_SECURITY;
-		} else {
-			size_t num_bytes = 0;
-			size_t b_size = MIN(1024U, len);
-			uint8_t *b = malloc(b_size);
-
-			if (!b)
+	if (!data && handle->shdr->img_type != SHDR_ENCRYPTED_TA) {
+		/* Skipped plain data isn't used, hash it in place */
+		res = crypto_hash_update(handle->hash_ctx, src, len);
+		if (res != TEE_SUCCESS)
+			return TEE_ERROR_SECURITY;
+	} else {
+		if (!data && !handle->bounce) {
+			/* Skipped encrypted data needs somewhere to go */
+			handle->bounce = malloc(REE_FS_TA_CHUNK_SIZE);
+			if (!handle->bounce)
 				return TEE_ERROR_OUT_OF_MEMORY;
+		}
 
-			dst = NULL;
-			while (num_bytes < len) {
-				size_t n = MIN(b_size, len - num_bytes);
-
-				res = tee_ta_decrypt_update(handle->enc_ctx, b,
-							    src + num_bytes, n);
-				if (res)
-					break;
-				num_bytes += n;
+		while (num_bytes < len) {
+			size_t n = MIN(REE_FS_TA_CHUNK_SIZE, len - num_bytes);
+			uint8_t *dst = handle->bounce;
 
-				res = crypto_hash_update(handle->hash_ctx, b,
-							 n);
-				if (res)
-					break;
-			}
-
-			free(b);
-			if (res != TEE_SUCCESS)
-				return TEE_ERROR_SECURITY;
+			if (data)
+				dst = (uint8_t *)data + num_bytes;
+			res = read_chunk(handle, dst, src + num_bytes, n);
+			if (res)
+				return res;
+			num_bytes += n;
 		}
-	} else if (data) {
-		dst = data; /* Hash secure buffer (shm might be modified) */
-		memcpy(dst, src, len);
-	}
-
-	if (dst) {
-		res = crypto_hash_update(handle->hash_ctx, dst, len);
-		if (res != TEE_SUCCESS)
-			return TEE_ERROR_SECURITY;
 	}
 
 	handle->offs = next_offs;
+out:
 	if (handle->offs == handle->nw_ta_size) {
 		if (handle->shdr->img_type == SHDR_ENCRYPTED_TA) {
 			/*
@@ -528,6 +614,8 @@ static void ree_fs_ta_close(struct ts_store_handle *h)
 	free(handle->shdr);
 	free(handle->ehdr);
 	free(handle->bs_hdr);
+	free(handle->bounce);
+	ta_inflate_free(handle->inflate);
 	free(handle);
 }
 
@@ -551,69 +639,324 @@ REGISTER_TA_STORE(9) = {
  * by the upper layer (ELF loader).
  */
 
-struct buf_ree_fs_ta_handle {
-	struct ts_store_handle *h; /* Note: a REE FS TA store handle */
+/*
+ * A verified TA image in the "Secure DDR" pool. It's shared by all the
+ * handles opened on it and, when CFG_REE_FS_TA_CACHE_ENTRIES > 0, kept in
+ * ta_cache after the last handle is closed.
+ */
+struct buf_ta_image {
+	TEE_UUID uuid;
 	size_t ta_size;
 	tee_mm_entry_t *mm;
 	uint8_t *buf;
-	size_t offs;
 	uint8_t *tag;
 	unsigned int tag_len;
+	unsigned int refcount;	/* Protected by ta_cache_mutex */
+	TAILQ_ENTRY(buf_ta_image) link;
 };
 
-static TEE_Result buf_ta_open(const TEE_UUID *uuid,
-			      struct ts_store_handle **h)
+struct buf_ree_fs_ta_handle {
+	struct buf_ta_image *img;
+	size_t offs;
+};
+
+/* Cached images, most recently used first */
+static TAILQ_HEAD(buf_ta_image_head, buf_ta_image) ta_cache =
+	TAILQ_HEAD_INITIALIZER(ta_cache);
+static size_t ta_cache_count;
+static struct ree_fs_ta_cache_stats ta_cache_stats;
+static struct mutex ta_cache_mutex = MUTEX_INITIALIZER;
+
+static void buf_ta_image_free(struct buf_ta_image *img)
 {
-	struct buf_ree_fs_ta_handle *handle = NULL;
+	tee_mm_free(img->mm);
+	free(img->tag);
+	free(img);
+}
+
+static void buf_ta_image_put(struct buf_ta_image *img)
+{
+	bool last_ref = false;
+
+	mutex_lock(&ta_cache_mutex);
+	assert(img->refcount);
+	img->refcount--;
+	last_ref = !img->refcount;
+	mutex_unlock(&ta_cache_mutex);
+
+	if (last_ref)
+		buf_ta_image_free(img);
+}
+
+/*
+ * Removes @img from the cache, called with ta_cache_mutex held. Returns
+ * @img if the cache held the last reference, in which case the caller
+ * has to free it once the mutex is released.
+ */
+static struct buf_ta_image *ta_cache_remove(struct buf_ta_image *img)
+{
+	TAILQ_REMOVE(&ta_cache, img, link);
+	ta_cache_count--;
+	img->refcount--;
+	if (img->refcount)
+		return NULL;
+	return img;
+}
+
+static struct buf_ta_image *ta_cache_get(const TEE_UUID *uuid)
+{
+	struct buf_ta_image *img = NULL;
+
+	if (!CFG_REE_FS_TA_CACHE_ENTRIES)
+		return NULL;
+
+	mutex_lock(&ta_cache_mutex);
+	TAILQ_FOREACH(img, &ta_cache, link) {
+		if (!memcmp(&img->uuid, uuid, sizeof(*uuid))) {
+			TAILQ_REMOVE(&ta_cache, img, link);
+			TAILQ_INSERT_HEAD(&ta_cache, img, link);
+			img->refcount++;
+			break;
+		}
+	}
+	mutex_unlock(&ta_cache_mutex);
+
+	return img;
+}
+
+static void ta_cache_count_open(bool hit)
+{
+	if (!CFG_REE_FS_TA_CACHE_ENTRIES)
+		return;
+
+	mutex_lock(&ta_cache_mutex);
+	if (hit)
+		ta_cache_stats.hits++;
+	else
+		ta_cache_stats.misses++;
+	mutex_unlock(&ta_cache_mutex);
+}
+
+static void ta_cache_add(struct buf_ta_image *img)
+{
+	struct buf_ta_image *old = NULL;
+	struct buf_ta_image *drop = NULL;
+
+	if (!CFG_REE_FS_TA_CACHE_ENTRIES)
+		return;
+
+	mutex_lock(&ta_cache_mutex);
+
+	/* Another thread may have loaded the same TA concurrently */
+	TAILQ_FOREACH(old, &ta_cache, link)
+		if (!memcmp(&old->uuid, &img->uuid, sizeof(img->uuid)))
+			break;
+	if (!old && ta_cache_count == CFG_REE_FS_TA_CACHE_ENTRIES) {
+		old = TAILQ_LAST(&ta_cache, buf_ta_image_head);
+		ta_cache_stats.evictions++;
+	}
+	if (old)
+		drop = ta_cache_remove(old);
+
+	TAILQ_INSERT_HEAD(&ta_cache, img, link);
+	ta_cache_count++;
+	img->refcount++;
+
+	mutex_unlock(&ta_cache_mutex);
+
+	if (drop)
+		buf_ta_image_free(drop);
+}
+
+#if CFG_REE_FS_TA_CACHE_ENTRIES
+void ree_fs_ta_cache_drop_unused(void)
+{
+	struct buf_ta_image *img = NULL;
+	struct buf_ta_image *next = NULL;
+	struct buf_ta_image *drop = NULL;
+
+	while (true) {
+		mutex_lock(&ta_cache_mutex);
+		TAILQ_FOREACH_SAFE(img, &ta_cache, link, next) {
+			if (img->refcount == 1) {
+				drop = ta_cache_remove(img);
+				ta_cache_stats.evictions++;
+				break;
+			}
+		}
+		mutex_unlock(&ta_cache_mutex);
+
+		if (!drop)
+			return;
+		buf_ta_image_free(drop);
+		drop = NULL;
+	}
+}
+
+void ree_fs_ta_cache_invalidate(const TEE_UUID *uuid)
+{
+	struct buf_ta_image *img = NULL;
+	struct buf_ta_image *drop = NULL;
+
+	mutex_lock(&ta_cache_mutex);
+	TAILQ_FOREACH(img, &ta_cache, link) {
+		if (!memcmp(&img->uuid, uuid, sizeof(*uuid))) {
+			drop = ta_cache_remove(img);
+			ta_cache_stats.invalidations++;
+			break;
+		}
+	}
+	mutex_unlock(&ta_cache_mutex);
+
+	if (drop)
+		buf_ta_image_free(drop);
+}
+
+void ree_fs_ta_cache_get_stats(struct ree_fs_ta_cache_stats *stats,
+			       bool reset)
+{
+	mutex_lock(&ta_cache_mutex);
+	*stats = ta_cache_stats;
+	if (reset)
+		ta_cache_stats = (struct ree_fs_ta_cache_stats){ };
+	mutex_unlock(&ta_cache_mutex);
+}
+#endif
+
+static tee_mm_entry_t *alloc_image_mem(size_t size)
+{
+	tee_mm_entry_t *mm = tee_mm_alloc(&tee_mm_sec_ddr, size);
+
+	if (!mm && CFG_REE_FS_TA_CACHE_ENTRIES) {
+		/* Cached images may be what's filling up the pool */
+		ree_fs_ta_cache_drop_unused();
+		mm = tee_mm_alloc(&tee_mm_sec_ddr, size);
+	}
+
+	return mm;
+}
+
+/* Reads and verifies the image supplied through @h into secure memory */
+static TEE_Result buf_ta_load(const TEE_UUID *uuid, struct ts_store_handle *h,
+			      struct buf_ta_image **img_ret)
+{
+	struct buf_ta_image *img = NULL;
 	TEE_Result res = TEE_SUCCESS;
 
-	handle = calloc(1, sizeof(*handle));
-	if (!handle)
+	img = calloc(1, sizeof(*img));
+	if (!img)
 		return TEE_ERROR_OUT_OF_MEMORY;
-	res = ree_fs_ta_open(uuid, &handle->h);
-	if (res)
-		goto err2;
-	res = ree_fs_ta_get_size(handle->h, &handle->ta_size);
+	res = ree_fs_ta_get_size(h, &img->ta_size);
 	if (res)
 		goto err;
 
-	res = ree_fs_ta_get_tag(handle->h, NULL, &handle->tag_len);
+	res = ree_fs_ta_get_tag(h, NULL, &img->tag_len);
 	if (res != TEE_ERROR_SHORT_BUFFER) {
 		res = TEE_ERROR_GENERIC;
 		goto err;
 	}
-	handle->tag = malloc(handle->tag_len);
-	if (!handle->tag) {
+	img->tag = malloc(img->tag_len);
+	if (!img->tag) {
 		res = TEE_ERROR_OUT_OF_MEMORY;
 		goto err;
 	}
-	res = ree_fs_ta_get_tag(handle->h, handle->tag, &handle->tag_len);
+	res = ree_fs_ta_get_tag(h, img->tag, &img->tag_len);
 	if (res)
 		goto err;
 
-	handle->mm = tee_mm_alloc(&tee_mm_sec_ddr, handle->ta_size);
-	if (!handle->mm) {
+	img->mm = alloc_image_mem(img->ta_size);
+	if (!img->mm) {
 		res = TEE_ERROR_OUT_OF_MEMORY;
 		goto err;
 	}
-	handle->buf = phys_to_virt(tee_mm_get_smem(handle->mm),
-				   MEM_AREA_TA_RAM, handle->ta_size);
-	if (!handle->buf) {
+	img->buf = phys_to_virt(tee_mm_get_smem(img->mm), MEM_AREA_TA_RAM,
+				img->ta_size);
+	if (!img->buf) {
 		res = TEE_ERROR_OUT_OF_MEMORY;
 		goto err;
 	}
-	res = ree_fs_ta_read(handle->h, handle->buf, handle->ta_size);
+	res = ree_fs_ta_read(h, img->buf, img->ta_size);
 	if (res)
 		goto err;
-	*h = (struct ts_store_handle *)handle;
+
+	img->uuid = *uuid;
+	img->refcount = 1;
+	*img_ret = img;
 err:
-	ree_fs_ta_close(handle->h);
-err2:
-	if (res) {
-		tee_mm_free(handle->mm);
-		free(handle->tag);
-		free(handle);
+	if (res)
+		buf_ta_image_free(img);
+	return res;
+}
+
+/*
+ * Checks that the cached @img is the image normal world currently
+ * supplies through @h, whose signed header only has been verified so
+ * far. Returns TEE_ERROR_ITEM_NOT_FOUND if the image has changed, or the
+ * error of the rollback check.
+ */
+static TEE_Result buf_ta_check_cached(struct ts_store_handle *h,
+				      struct buf_ta_image *img)
+{
+	struct ree_fs_ta_handle *handle = (struct ree_fs_ta_handle *)h;
+	struct shdr *shdr = handle->shdr;
+
+	if (shdr->hash_size != img->tag_len ||
+	    memcmp(SHDR_GET_HASH(shdr), img->tag, img->tag_len))
+		return TEE_ERROR_ITEM_NOT_FOUND;
+
+	if (handle->bs_hdr)
+		return check_update_version(handle->bs_hdr);
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result buf_ta_open(const TEE_UUID *uuid,
+			      struct ts_store_handle **h)
+{
+	struct buf_ree_fs_ta_handle *handle = NULL;
+	struct ts_store_handle *ree_h = NULL;
+	TEE_Result res = TEE_SUCCESS;
+
+	handle = calloc(1, sizeof(*handle));
+	if (!handle)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	/*
+	 * Normal world is always asked for the image, even if it's cached,
+	 * so a replaced or rolled back TA is noticed. Only the signed
+	 * header is verified before a cached image is used, which saves
+	 * copying and hashing the whole image.
+	 */
+	res = ree_fs_ta_open(uuid, &ree_h);
+	if (res)
+		goto err;
+
+	handle->img = ta_cache_get(uuid);
+	if (handle->img) {
+		res = buf_ta_check_cached(ree_h, handle->img);
+		if (res) {
+			buf_ta_image_put(handle->img);
+			handle->img = NULL;
+			ree_fs_ta_cache_invalidate(uuid);
+			if (res != TEE_ERROR_ITEM_NOT_FOUND)
+				goto err;
+		}
+	}
+	ta_cache_count_open(!!handle->img);
+
+	if (!handle->img) {
+		res = buf_ta_load(uuid, ree_h, &handle->img);
+		if (res)
+			goto err;
+		ta_cache_add(handle->img);
 	}
+
+	ree_fs_ta_close(ree_h);
+	*h = (struct ts_store_handle *)handle;
+	return TEE_SUCCESS;
+err:
+	ree_fs_ta_close(ree_h);
+	free(handle);
 	return res;
 }
 
@@ -622,7 +965,7 @@ static TEE_Result buf_ta_get_size(const struct ts_store_handle *h,
 {
 	struct buf_ree_fs_ta_handle *handle = (struct buf_ree_fs_ta_handle *)h;
 
-	*size = handle->ta_size;
+	*size = handle->img->ta_size;
 	return TEE_SUCCESS;
 }
 
@@ -630,11 +973,11 @@ static TEE_Result buf_ta_read(struct ts_store_handle *h, void *data,
 			      size_t len)
 {
 	struct buf_ree_fs_ta_handle *handle = (struct buf_ree_fs_ta_handle *)h;
-	uint8_t *src = handle->buf + handle->offs;
+	uint8_t *src = handle->img->buf + handle->offs;
 	size_t next_offs = 0;
 
 	if (ADD_OVERFLOW(handle->offs, len, &next_offs) ||
-	    next_offs > handle->ta_size)
+	    next_offs > handle->img->ta_size)
 		return TEE_ERROR_BAD_PARAMETERS;
 
 	if (data)
@@ -647,12 +990,13 @@ static TEE_Result buf_ta_get_tag(const struct ts_store_handle *h,
 				 uint8_t *tag, unsigned int *tag_len)
 {
 	struct buf_ree_fs_ta_handle *handle = (struct buf_ree_fs_ta_handle *)h;
+	struct buf_ta_image *img = handle->img;
 
-	*tag_len = handle->tag_len;
-	if (!tag || *tag_len < handle->tag_len)
+	*tag_len = img->tag_len;
+	if (!tag || *tag_len < img->tag_len)
 		return TEE_ERROR_SHORT_BUFFER;
 
-	memcpy(tag, handle->tag, handle->tag_len);
+	memcpy(tag, img->tag, img->tag_len);
 
 	return TEE_SUCCESS;
 }
@@ -663,8 +1007,7 @@ static void buf_ta_close(struct ts_store_handle *h)
 
 	if (!handle)
 		return;
-	tee_mm_free(handle->mm);
-	free(handle->tag);
+	buf_ta_image_put(handle->img);
 	free(handle);
 }
 
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, The OP-TEE Project Contributors
+ */
+
+#include <assert.h>
+#include <atomic.h>
+#include <kernel/misc.h>
+#include <kernel/panic.h>
+#include <kernel/rwlock.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
+
+/*
+ * A reader announces itself by incrementing its core counter and then
+ * checks rw->write_locked, a writer sets rw->write_locked and then sums
+ * the counters. Both sides need a full barrier between the store and the
+ * load, or each could miss the other.
+ */
+static void full_barrier(void)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static uint32_t count_readers(struct rwlock *rw)
+{
+	uint32_t sum = 0;
+	size_t n = 0;
+
+	for (n = 0; n < CFG_TEE_CORE_NB_CORE; n++)
+		sum += atomic_load_u32(&rw->readers[n].count);
+
+	return sum;
+}
+
+/*
+ * Called with foreign interrupts masked. Returns true if a writer is
+ * waiting for the readers to drain and needs to be woken up.
+ */
+static bool dec_reader(struct rwlock *rw)
+{
+	uint32_t *cnt = &rw->readers[get_core_pos()].count;
+
+	atomic_store_u32(cnt, *cnt - 1);
+	full_barrier();
+
+	return atomic_load_u32(&rw->writer_waiting);
+}
+
+static bool read_enter(struct rwlock *rw, bool *wake_writer)
+{
+	uint32_t exceptions = thread_mask_exceptions(THREAD_EXCP_FOREIGN_INTR);
+	uint32_t *cnt = &rw->readers[get_core_pos()].count;
+	bool entered = false;
+
+	atomic_store_u32(cnt, *cnt + 1);
+	full_barrier();
+
+	entered = !atomic_load_u32(&rw->write_locked);
+	if (!entered)
+		*wake_writer = dec_reader(rw);
+
+	thread_unmask_exceptions(exceptions);
+
+	return entered;
+}
+
+static void wake_writer(struct rwlock *rw)
+{
+	wq_wake_next(&rw->write_wq, rw, NULL, -1);
+}
+
+static void release_readers(struct rwlock *rw)
+{
+	atomic_store_u32(&rw->write_locked, 0);
+	full_barrier();
+	wq_wake_next(&rw->read_wq, rw, NULL, -1);
+}
+
+void rwlock_init(struct rwlock *rw, bool writer_pref)
+{
+	*rw = (struct rwlock)RWLOCK_INITIALIZER;
+	rw->writer_pref = writer_pref;
+}
+
+void rwlock_destroy(struct rwlock *rw)
+{
+	/*
+	 * Caller guarantees that no one will try to take the lock so
+	 * there's no need to synchronize with other cores.
+	 */
+	if (count_readers(rw) || rw->write_locked)
+		panic();
+	if (!wq_is_empty(&rw->read_wq) || !wq_is_empty(&rw->write_wq))
+		panic("waitqueue not empty");
+	mutex_destroy(&rw->m);
+}
+
+void rwlock_read_lock(struct rwlock *rw)
+{
+	assert_have_no_spinlock();
+	assert(thread_get_id_may_fail() != THREAD_ID_INVALID);
+	assert(thread_is_in_normal_mode());
+
+	while (true) {
+		struct wait_queue_elem wqe = { };
+		bool wake = false;
+
+		if (read_enter(rw, &wake))
+			return;
+
+		if (wake)
+			wake_writer(rw);
+
+		/*
+		 * The wqe must be queued before checking rw->write_locked
+		 * again to guarantee that we don't miss the wakeup from
+		 * release_readers().
+		 */
+		wq_wait_init(&rw->read_wq, &wqe, true /* wait_read */);
+		if (atomic_load_u32(&rw->write_locked))
+			wq_wait_final(&rw->read_wq, &wqe, rw, NULL, -1);
+		else
+			wq_wait_cancel(&rw->read_wq, &wqe);
+	}
+}
+
+bool rwlock_read_trylock(struct rwlock *rw)
+{
+	bool wake = false;
+
+	assert_have_no_spinlock();
+	assert(thread_get_id_may_fail() != THREAD_ID_INVALID);
+
+	if (read_enter(rw, &wake))
+		return true;
+
+	if (wake)
+		wake_writer(rw);
+
+	return false;
+}
+
+void rwlock_read_unlock(struct rwlock *rw)
+{
+	uint32_t exceptions = 0;
+	bool wake = false;
+
+	assert_have_no_spinlock();
+	assert(thread_get_id_may_fail() != THREAD_ID_INVALID);
+
+	exceptions = thread_mask_exceptions(THREAD_EXCP_FOREIGN_INTR);
+	wake = dec_reader(rw);
+	thread_unmask_exceptions(exceptions);
+
+	if (wake)
+		wake_writer(rw);
+}
+
+void rwlock_write_lock(struct rwlock *rw)
+{
+	mutex_lock(&rw->m);
+
+	while (true) {
+		struct wait_queue_elem wqe = { };
+
+		/*
+		 * The wqe must be queued before publishing
+		 * rw->writer_waiting to guarantee that we don't miss the
+		 * wakeup from the last reader leaving.
+		 */
+		wq_wait_init(&rw->write_wq, &wqe, false /* wait_read */);
+		atomic_store_u32(&rw->writer_waiting, 1);
+		full_barrier();
+
+		/*
+		 * Without writer preference new readers are only turned
+		 * away once all current readers have left.
+		 */
+		if (rw->writer_pref || !count_readers(rw)) {
+			atomic_store_u32(&rw->write_locked, 1);
+			full_barrier();
+
+			if (!count_readers(rw)) {
+				atomic_store_u32(&rw->writer_waiting, 0);
+				wq_wait_cancel(&rw->write_wq, &wqe);
+				return;
+			}
+
+			if (!rw->writer_pref)
+				release_readers(rw);
+		}
+
+		wq_wait_final(&rw->write_wq, &wqe, rw, NULL, -1);
+	}
+}
+
+bool rwlock_write_trylock(struct rwlock *rw)
+{
+	if (!mutex_trylock(&rw->m))
+		return false;
+
+	atomic_store_u32(&rw->write_locked, 1);
+	full_barrier();
+
+	if (!count_readers(rw))
+		return true;
+
+	release_readers(rw);
+	mutex_unlock(&rw->m);
+
+	return false;
+}
+
+void rwlock_write_unlock(struct rwlock *rw)
+{
+	assert(rw->write_locked);
+
+	release_readers(rw);
+	mutex_unlock(&rw->m);
+}
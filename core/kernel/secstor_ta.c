@@ -3,65 +3,145 @@
  * Copyright (c) 2017, Linaro Limited
  */
 
+#include <config.h>
 #include <tee/tadb.h>
+#include <kernel/ta_inflate.h>
 #include <kernel/ts_store.h>
 #include <kernel/user_ta.h>
 #include <initcall.h>
+#include <signed_hdr.h>
+#include <stdlib.h>
+#include <util.h>
+
+struct secstor_ta_handle {
+	struct tee_tadb_ta_read *ta;
+	struct ta_inflate *inflate;	/* Only for compressed TAs */
+	size_t uncompressed_size;
+	size_t remaining;		/* Stored bytes not read yet */
+};
+
+static TEE_Result secstor_ta_fill(void *ctx, uint8_t *buf, size_t *len)
+{
+	struct secstor_ta_handle *h = ctx;
+	size_t l = MIN(*len, h->remaining);
+	TEE_Result res = TEE_SUCCESS;
+
+	*len = l;
+	if (!l)
+		return TEE_SUCCESS;
+
+	res = tee_tadb_ta_read(h->ta, buf, len);
+	if (res)
+		return res;
+	if (*len != l)
+		return TEE_ERROR_CORRUPT_OBJECT;
+	h->remaining -= l;
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * A TA installed from a SHDR_COMPRESSED_TA image is stored compressed with
+ * a struct tee_tadb_compressed_custom as custom properties. Other custom
+ * properties are skipped.
+ */
+static TEE_Result read_custom(struct secstor_ta_handle *h, size_t size)
+{
+	struct tee_tadb_compressed_custom custom = { };
+	TEE_Result res = TEE_SUCCESS;
+	size_t l = size;
+
+	if (size != sizeof(custom)) {
+		res = tee_tadb_ta_read(h->ta, NULL, &l);
+		if (res)
+			return res;
+		if (l != size)
+			return TEE_ERROR_CORRUPT_OBJECT;
+		return TEE_SUCCESS;
+	}
+
+	res = tee_tadb_ta_read(h->ta, &custom, &l);
+	if (res)
+		return res;
+	if (l != size)
+		return TEE_ERROR_CORRUPT_OBJECT;
+	if (custom.magic != TEE_TADB_COMPRESSED_MAGIC)
+		return TEE_SUCCESS;
+	if (!IS_ENABLED(CFG_TA_COMPRESSED_IMAGES))
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	h->uncompressed_size = custom.chdr.uncompressed_size;
+	return ta_inflate_alloc(custom.chdr.comp_algo,
+				custom.chdr.uncompressed_size,
+				secstor_ta_fill, h, &h->inflate);
+}
 
 static TEE_Result secstor_ta_open(const TEE_UUID *uuid,
 				  struct ts_store_handle **handle)
 {
 	TEE_Result res;
-	struct tee_tadb_ta_read *ta;
-	size_t l;
+	struct secstor_ta_handle *h = NULL;
 	const struct tee_tadb_property *prop;
 
-	res = tee_tadb_ta_open(uuid, &ta);
-	if (res)
+	h = calloc(1, sizeof(*h));
+	if (!h)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	res = tee_tadb_ta_open(uuid, &h->ta);
+	if (res) {
+		free(h);
 		return res;
-	prop = tee_tadb_ta_get_property(ta);
+	}
+	prop = tee_tadb_ta_get_property(h->ta);
+	h->remaining = prop->bin_size;
 
-	l = prop->custom_size;
-	res = tee_tadb_ta_read(ta, NULL, &l);
+	res = read_custom(h, prop->custom_size);
 	if (res)
 		goto err;
-	if (l != prop->custom_size) {
-		res = TEE_ERROR_CORRUPT_OBJECT;
-		goto err;
-	}
 
-	*handle = (struct ts_store_handle *)ta;
+	*handle = (struct ts_store_handle *)h;
 
 	return TEE_SUCCESS;
 err:
-	tee_tadb_ta_close(ta);
+	ta_inflate_free(h->inflate);
+	tee_tadb_ta_close(h->ta);
+	free(h);
 	return res;
 }
 
-static TEE_Result secstor_ta_get_size(const struct ts_store_handle *h,
+static TEE_Result secstor_ta_get_size(const struct ts_store_handle *handle,
 				      size_t *size)
 {
-	struct tee_tadb_ta_read *ta = (struct tee_tadb_ta_read *)h;
-	const struct tee_tadb_property *prop = tee_tadb_ta_get_property(ta);
+	struct secstor_ta_handle *h = (struct secstor_ta_handle *)handle;
+	const struct tee_tadb_property *prop = tee_tadb_ta_get_property(h->ta);
 
-	*size = prop->bin_size;
+	if (h->inflate)
+		*size = h->uncompressed_size;
+	else
+		*size = prop->bin_size;
 
 	return TEE_SUCCESS;
 }
 
-static TEE_Result secstor_ta_get_tag(const struct ts_store_handle *h,
+static TEE_Result secstor_ta_get_tag(const struct ts_store_handle *handle,
 				     uint8_t *tag, unsigned int *tag_len)
 {
-	return tee_tadb_get_tag((struct tee_tadb_ta_read *)h, tag, tag_len);
+	struct secstor_ta_handle *h = (struct secstor_ta_handle *)handle;
+
+	return tee_tadb_get_tag(h->ta, tag, tag_len);
 }
 
-static TEE_Result secstor_ta_read(struct ts_store_handle *h, void *data,
+static TEE_Result secstor_ta_read(struct ts_store_handle *handle, void *data,
 				  size_t len)
 {
-	struct tee_tadb_ta_read *ta = (struct tee_tadb_ta_read *)h;
+	struct secstor_ta_handle *h = (struct secstor_ta_handle *)handle;
 	size_t l = len;
-	TEE_Result res = tee_tadb_ta_read(ta, data, &l);
+	TEE_Result res = TEE_SUCCESS;
+
+	if (h->inflate)
+		return ta_inflate_read(h->inflate, data, len);
 
+	res = tee_tadb_ta_read(h->ta, data, &l);
 	if (res)
 		return res;
 	if (l != len)
@@ -70,11 +150,13 @@ static TEE_Result secstor_ta_read(struct ts_store_handle *h, void *data,
 	return TEE_SUCCESS;
 }
 
-static void secstor_ta_close(struct ts_store_handle *h)
+static void secstor_ta_close(struct ts_store_handle *handle)
 {
-	struct tee_tadb_ta_read *ta = (struct tee_tadb_ta_read *)h;
+	struct secstor_ta_handle *h = (struct secstor_ta_handle *)handle;
 
-	tee_tadb_ta_close(ta);
+	ta_inflate_free(h->inflate);
+	tee_tadb_ta_close(h->ta);
+	free(h);
 }
 
 REGISTER_TA_STORE(4) = {
@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, The OP-TEE Project Contributors
+ */
+
+#include <kernel/ta_inflate.h>
+#include <signed_hdr.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace.h>
+#include <util.h>
+#include <zlib.h>
+
+/* Size of the secure buffer holding compressed input */
+#define TA_INFLATE_CHUNK_SIZE	(8 * 1024U)
+
+struct ta_inflate {
+	z_stream strm;
+	ta_inflate_fill_t fill;
+	void *fill_ctx;
+	size_t size;		/* Uncompressed size */
+	size_t offs;		/* Uncompressed bytes read so far */
+	bool input_end;		/* fill() has returned all compressed data */
+	bool stream_end;	/* inflate() has returned Z_STREAM_END */
+	uint8_t *discard;	/* Destination of skipped data */
+	uint8_t in_buf[TA_INFLATE_CHUNK_SIZE];
+};
+
+static void *zalloc(void *opaque __unused, unsigned int items,
+		    unsigned int size)
+{
+	return malloc(items * size);
+}
+
+static void zfree(void *opaque __unused, void *address)
+{
+	free(address);
+}
+
+static TEE_Result refill(struct ta_inflate *inf)
+{
+	size_t l = sizeof(inf->in_buf);
+	TEE_Result res = TEE_SUCCESS;
+
+	res = inf->fill(inf->fill_ctx, inf->in_buf, &l);
+	if (res)
+		return res;
+	if (!l)
+		inf->input_end = true;
+
+	inf->strm.next_in = inf->in_buf;
+	inf->strm.avail_in = l;
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Runs inflate() until the output buffer is full or the compressed stream
+ * ends, whichever comes first.
+ */
+static TEE_Result inflate_more(struct ta_inflate *inf)
+{
+	z_stream *strm = &inf->strm;
+	TEE_Result res = TEE_SUCCESS;
+	int st = Z_OK;
+
+	while (strm->avail_out && !inf->stream_end) {
+		if (!strm->avail_in && !inf->input_end) {
+			res = refill(inf);
+			if (res)
+				return res;
+		}
+
+		st = inflate(strm, Z_NO_FLUSH);
+		if (st == Z_STREAM_END) {
+			inf->stream_end = true;
+		} else if (st == Z_BUF_ERROR) {
+			/* No progress possible, truncated input? */
+			if (!strm->avail_in && inf->input_end)
+				return TEE_ERROR_BAD_FORMAT;
+		} else if (st != Z_OK) {
+			EMSG("Decompression error (%d)", st);
+			return TEE_ERROR_BAD_FORMAT;
+		}
+	}
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result inflate_to(struct ta_inflate *inf, uint8_t *out, size_t len)
+{
+	TEE_Result res = TEE_SUCCESS;
+
+	inf->strm.next_out = out;
+	inf->strm.avail_out = len;
+
+	res = inflate_more(inf);
+	if (res)
+		return res;
+
+	/* Stream ended before the announced size */
+	if (inf->strm.avail_out)
+		return TEE_ERROR_BAD_FORMAT;
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Checks that the compressed stream ends with the uncompressed binary and
+ * that nothing follows the stream, so the store has seen all of the
+ * compressed data once the binary has been read.
+ */
+static TEE_Result check_end(struct ta_inflate *inf)
+{
+	uint8_t extra = 0;
+	TEE_Result res = TEE_SUCCESS;
+
+	/* The checksum trailer may still be pending */
+	res = inflate_to(inf, &extra, sizeof(extra));
+	if (!res)
+		return TEE_ERROR_BAD_FORMAT; /* Longer than announced */
+	if (!inf->stream_end)
+		return res;
+
+	while (!inf->strm.avail_in && !inf->input_end) {
+		res = refill(inf);
+		if (res)
+			return res;
+	}
+	if (inf->strm.avail_in)
+		return TEE_ERROR_BAD_FORMAT;
+
+	return TEE_SUCCESS;
+}
+
+TEE_Result ta_inflate_alloc(uint32_t comp_algo, size_t uncompressed_size,
+			    ta_inflate_fill_t fill, void *fill_ctx,
+			    struct ta_inflate **inf_ret)
+{
+	struct ta_inflate *inf = NULL;
+	int st = Z_OK;
+
+	if (comp_algo != SHDR_COMP_ALGO_ZLIB)
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	inf = calloc(1, sizeof(*inf));
+	if (!inf)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	inf->strm.zalloc = zalloc;
+	inf->strm.zfree = zfree;
+	st = inflateInit(&inf->strm);
+	if (st != Z_OK) {
+		EMSG("Decompression initialization error (%d)", st);
+		free(inf);
+		return TEE_ERROR_OUT_OF_MEMORY;
+	}
+
+	inf->fill = fill;
+	inf->fill_ctx = fill_ctx;
+	inf->size = uncompressed_size;
+	*inf_ret = inf;
+
+	return TEE_SUCCESS;
+}
+
+TEE_Result ta_inflate_read(struct ta_inflate *inf, void *data, size_t len)
+{
+	TEE_Result res = TEE_SUCCESS;
+	size_t next_offs = 0;
+	size_t num_bytes = 0;
+
+	if (ADD_OVERFLOW(inf->offs, len, &next_offs) || next_offs > inf->size)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (data) {
+		res = inflate_to(inf, data, len);
+		if (res)
+			return res;
+	} else {
+		if (!inf->discard && len) {
+			inf->discard = malloc(TA_INFLATE_CHUNK_SIZE);
+			if (!inf->discard)
+				return TEE_ERROR_OUT_OF_MEMORY;
+		}
+
+		while (num_bytes < len) {
+			size_t n = MIN(TA_INFLATE_CHUNK_SIZE, len - num_bytes);
+
+			res = inflate_to(inf, inf->discard, n);
+			if (res)
+				return res;
+			num_bytes += n;
+		}
+	}
+
+	inf->offs = next_offs;
+	if (inf->offs == inf->size)
+		return check_end(inf);
+
+	return TEE_SUCCESS;
+}
+
+bool ta_inflate_done(struct ta_inflate *inf)
+{
+	return inf->offs == inf->size;
+}
+
+void ta_inflate_free(struct ta_inflate *inf)
+{
+	if (!inf)
+		return;
+	inflateEnd(&inf->strm);
+	free(inf->discard);
+	free(inf);
+}
@@ -9,6 +9,7 @@
 #include <kernel/mutex.h>
 #include <kernel/panic.h>
 #include <kernel/pseudo_ta.h>
+#include <kernel/spinlock.h>
 #include <kernel/stmm_sp.h>
 #include <kernel/tee_common.h>
 #include <kernel/tee_misc.h>
@@ -42,6 +43,32 @@ struct mutex tee_ta_mutex = MUTEX_INITIALIZER;
 struct condvar tee_ta_init_cv = CONDVAR_INITIALIZER;
 struct tee_ta_ctx_head tee_ctxes = TAILQ_HEAD_INITIALIZER(tee_ctxes);
 
+/*
+ * Freshly loaded user TA contexts which haven't been entered yet, least
+ * recently used first, see idle_pool_prewarm(). A context is marked idle
+ * as soon as it's published in tee_ctxes but is only added here once it
+ * has been loaded. Protected by tee_ta_mutex.
+ */
+static struct tee_ta_ctx_head idle_ctxes = TAILQ_HEAD_INITIALIZER(idle_ctxes);
+static size_t idle_count;
+
+/*
+ * Number of log2 buckets in the open latency histogram, bucket n counts
+ * opens which took [2^(n - 1), 2^n) counter ticks.
+ */
+#define OPEN_STATS_NUM_BUCKETS	32
+
+struct open_stats {
+	uint32_t count;
+	uint32_t idle_hits;
+	uint32_t idle_evictions;
+	uint32_t buckets[OPEN_STATS_NUM_BUCKETS];
+};
+
+/* Protected by open_stats_lock */
+static struct open_stats open_stats;
+static unsigned int open_stats_lock = SPINLOCK_UNLOCK;
+
 #ifndef CFG_CONCURRENT_SINGLE_INSTANCE_TA
 static struct condvar tee_ta_cv = CONDVAR_INITIALIZER;
 static short int tee_ta_single_instance_thread = THREAD_ID_INVALID;
@@ -391,6 +418,271 @@ static struct tee_ta_ctx *tee_ta_context_find(const TEE_UUID *uuid)
 	return NULL;
 }
 
+static void open_stats_count_idle(bool hit)
+{
+	uint32_t exceptions = cpu_spin_lock_xsave(&open_stats_lock);
+
+	if (hit)
+		open_stats.idle_hits++;
+	else
+		open_stats.idle_evictions++;
+	cpu_spin_unlock_xrestore(&open_stats_lock, exceptions);
+}
+
+static void idle_pool_remove(struct tee_ta_ctx *ctx)
+{
+	TAILQ_REMOVE(&idle_ctxes, ctx, idle_link);
+	ctx->idle = false;
+	idle_count--;
+}
+
+/*
+ * Hands the idle context @ctx over to a session, called with tee_ta_mutex
+ * held. @ctx may still be waiting to be added to the pool by
+ * idle_pool_prewarm().
+ */
+static void idle_pool_claim(struct tee_ta_ctx *ctx)
+{
+	struct tee_ta_ctx *c = NULL;
+
+	TAILQ_FOREACH(c, &idle_ctxes, idle_link) {
+		if (c == ctx) {
+			idle_pool_remove(ctx);
+			break;
+		}
+	}
+	ctx->idle = false;
+	open_stats_count_idle(true);
+}
+
+/*
+ * Takes an idle instance of multi instance TA @uuid out of the pool,
+ * returns NULL if there's none. Called with tee_ta_mutex held.
+ */
+static struct tee_ta_ctx *idle_pool_get(const TEE_UUID *uuid)
+{
+	struct tee_ta_ctx *ctx = NULL;
+
+	TAILQ_FOREACH_REVERSE(ctx, &idle_ctxes, tee_ta_ctx_head, idle_link) {
+		if (!memcmp(&ctx->ts_ctx.uuid, uuid, sizeof(*uuid))) {
+			idle_pool_claim(ctx);
+			return ctx;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Adds the never entered context @ctx to the pool, called with
+ * tee_ta_mutex held. Returns an idle context evicted to respect the
+ * limits, already removed from tee_ctxes, which the caller is supposed
+ * to destroy once tee_ta_mutex has been released, or NULL.
+ */
+static struct tee_ta_ctx *idle_pool_add(struct tee_ta_ctx *ctx)
+{
+	struct tee_ta_ctx *victim = NULL;
+	struct tee_ta_ctx *c = NULL;
+	size_t uuid_count = 0;
+
+	ctx->idle = true;
+	TAILQ_INSERT_TAIL(&idle_ctxes, ctx, idle_link);
+	idle_count++;
+
+	TAILQ_FOREACH(c, &idle_ctxes, idle_link) {
+		if (!memcmp(&c->ts_ctx.uuid, &ctx->ts_ctx.uuid,
+			    sizeof(TEE_UUID))) {
+			if (!victim)
+				victim = c;
+			uuid_count++;
+		}
+	}
+
+	if (uuid_count <= CFG_TA_IDLE_POOL_PER_UUID) {
+		if (idle_count <= CFG_TA_IDLE_POOL_SIZE)
+			return NULL;
+		victim = TAILQ_FIRST(&idle_ctxes);
+	}
+
+	idle_pool_remove(victim);
+	TAILQ_REMOVE(&tee_ctxes, victim, link);
+	open_stats_count_idle(false);
+
+	return victim;
+}
+
+/*
+ * Tells if a fresh instance should be loaded in the pool to replace @ctx
+ * when its last session has been closed.
+ */
+static bool idle_pool_wanted(struct tee_ta_ctx *ctx)
+{
+	return CFG_TA_IDLE_POOL_SIZE && CFG_TA_IDLE_POOL_PER_UUID &&
+	       !ctx->panicked && is_user_ta_ctx(&ctx->ts_ctx);
+}
+
+/* Tells if there's another context than @ctx of the same TA */
+static bool other_context_exists(struct tee_ta_ctx *ctx)
+{
+	struct tee_ta_ctx *c = NULL;
+
+	TAILQ_FOREACH(c, &tee_ctxes, link)
+		if (c != ctx && !memcmp(&c->ts_ctx.uuid, &ctx->ts_ctx.uuid,
+					sizeof(TEE_UUID)))
+			return true;
+
+	return false;
+}
+
+/*
+ * Loads a new instance of TA @uuid and keeps it in the pool without
+ * entering it, so the next session opened to the TA skips loading it.
+ * As the instance isn't entered before that session, TA_CreateEntryPoint()
+ * is called as for any other new instance. Failures only mean that
+ * there's no idle instance.
+ *
+ * This is called by the thread closing the last session of the previous
+ * instance and the complete load, with ldelf and all, is done before the
+ * close returns to normal world. That's the price for having the next
+ * open skip the load.
+ */
+static void idle_pool_prewarm(const TEE_UUID *uuid)
+{
+	struct tee_ta_session *s = calloc(1, sizeof(*s));
+	struct tee_ta_ctx *victim = NULL;
+	struct tee_ta_ctx *ctx = NULL;
+
+	if (!s)
+		return;
+
+	/* A session to load the instance with, never entered */
+	s->cancel_mask = true;
+	condvar_init(&s->refc_cv);
+	condvar_init(&s->lock_cv);
+	s->lock_thread = THREAD_ID_INVALID;
+	s->ref_count = 1;
+
+	if (tee_ta_init_user_ta_idle(uuid, s)) {
+		free(s);
+		return;
+	}
+
+	ctx = ts_to_ta_ctx(s->ts_sess.ctx);
+	free(s);
+
+	mutex_lock(&tee_ta_mutex);
+	/* A session to a single instance TA may have claimed it already */
+	if (ctx->idle) {
+		if ((ctx->flags & TA_FLAG_SINGLE_INSTANCE) &&
+		    other_context_exists(ctx)) {
+			/* A session loaded its own instance meanwhile */
+			ctx->idle = false;
+			TAILQ_REMOVE(&tee_ctxes, ctx, link);
+			victim = ctx;
+		} else {
+			victim = idle_pool_add(ctx);
+		}
+	}
+	mutex_unlock(&tee_ta_mutex);
+
+	if (victim)
+		destroy_context(victim);
+}
+
+bool tee_ta_idle_pool_flush(void)
+{
+	struct tee_ta_ctx *ctx = NULL;
+	bool flushed = false;
+
+	while (true) {
+		mutex_lock(&tee_ta_mutex);
+		ctx = TAILQ_FIRST(&idle_ctxes);
+		if (ctx) {
+			idle_pool_remove(ctx);
+			TAILQ_REMOVE(&tee_ctxes, ctx, link);
+			open_stats_count_idle(false);
+		}
+		mutex_unlock(&tee_ta_mutex);
+
+		if (!ctx)
+			return flushed;
+
+		destroy_context(ctx);
+		flushed = true;
+	}
+}
+
+void tee_ta_idle_pool_invalidate(const TEE_UUID *uuid)
+{
+	struct tee_ta_ctx *ctx = NULL;
+
+	while (true) {
+		mutex_lock(&tee_ta_mutex);
+		TAILQ_FOREACH(ctx, &idle_ctxes, idle_link)
+			if (!memcmp(&ctx->ts_ctx.uuid, uuid, sizeof(*uuid)))
+				break;
+		if (ctx) {
+			idle_pool_remove(ctx);
+			TAILQ_REMOVE(&tee_ctxes, ctx, link);
+		}
+		mutex_unlock(&tee_ta_mutex);
+
+		if (!ctx)
+			return;
+
+		destroy_context(ctx);
+	}
+}
+
+static unsigned int open_stats_bucket(uint64_t ticks)
+{
+	unsigned int n = 0;
+
+	if (ticks)
+		n = 64 - __builtin_clzll(ticks);
+
+	return MIN(n, (unsigned int)OPEN_STATS_NUM_BUCKETS - 1);
+}
+
+/* Returns the upper bound in microseconds of the @pct percentile bucket */
+static uint32_t open_stats_percentile(struct open_stats *st, unsigned int pct)
+{
+	uint64_t sum = 0;
+	size_t n = 0;
+
+	if (!st->count)
+		return 0;
+
+	for (n = 0; n < OPEN_STATS_NUM_BUCKETS - 1; n++) {
+		sum += st->buckets[n];
+		if (sum * 100 >= (uint64_t)st->count * pct)
+			break;
+	}
+
+	if (!n)
+		return 0;
+	return (SHIFT_U64(1, n) * 1000000) / read_cntfrq();
+}
+
+void tee_ta_get_open_stats(struct tee_ta_open_stats *stats, bool reset)
+{
+	struct open_stats st = { };
+	uint32_t exceptions = 0;
+
+	exceptions = cpu_spin_lock_xsave(&open_stats_lock);
+	st = open_stats;
+	if (reset)
+		open_stats = (struct open_stats){ };
+	cpu_spin_unlock_xrestore(&open_stats_lock, exceptions);
+
+	stats->count = st.count;
+	stats->idle_hits = st.idle_hits;
+	stats->idle_evictions = st.idle_evictions;
+	stats->p50_us = open_stats_percentile(&st, 50);
+	stats->p90_us = open_stats_percentile(&st, 90);
+	stats->p99_us = open_stats_percentile(&st, 99);
+}
+
 /* check if requester (client ID) matches session initial client */
 static TEE_Result check_client(struct tee_ta_session *s, const TEE_Identity *id)
 {
@@ -558,10 +850,15 @@ TEE_Result tee_ta_close_session(struct tee_ta_session *csess,
 	keep_alive = (ctx->flags & TA_FLAG_INSTANCE_KEEP_ALIVE) &&
 			(ctx->flags & TA_FLAG_SINGLE_INSTANCE);
 	if (!ctx->ref_count && !keep_alive) {
+		TEE_UUID uuid = ctx->ts_ctx.uuid;
+		bool prewarm = idle_pool_wanted(ctx);
+
 		TAILQ_REMOVE(&tee_ctxes, ctx, link);
 		mutex_unlock(&tee_ta_mutex);
 
 		destroy_context(ctx);
+		if (prewarm)
+			idle_pool_prewarm(&uuid);
 	} else
 		mutex_unlock(&tee_ta_mutex);
 
@@ -594,10 +891,16 @@ static TEE_Result tee_ta_init_session_with_context(struct tee_ta_session *s,
 	 * If TA isn't single instance it should be loaded as new
 	 * instance instead of doing anything with this instance.
 	 * So tell the caller that we didn't find the TA it the
-	 * caller will load a new instance.
+	 * caller will load a new instance, unless there's an idle
+	 * instance which can be used instead.
 	 */
-	if ((ctx->flags & TA_FLAG_SINGLE_INSTANCE) == 0)
-		return TEE_ERROR_ITEM_NOT_FOUND;
+	if ((ctx->flags & TA_FLAG_SINGLE_INSTANCE) == 0) {
+		ctx = idle_pool_get(uuid);
+		if (!ctx)
+			return TEE_ERROR_ITEM_NOT_FOUND;
+	} else if (ctx->idle) {
+		idle_pool_claim(ctx);
+	}
 
 	/*
 	 * The TA is single instance, if it isn't multi session we
@@ -685,6 +988,8 @@ static TEE_Result tee_ta_init_session(TEE_ErrorOrigin *err,
 
 	/* Look for user TA */
 	res = tee_ta_init_user_ta_session(uuid, s);
+	if (res == TEE_ERROR_OUT_OF_MEMORY && tee_ta_idle_pool_flush())
+		res = tee_ta_init_user_ta_session(uuid, s);
 
 out:
 	if (!res) {
@@ -700,7 +1005,7 @@ err_mutex_unlock:
 	return res;
 }
 
-TEE_Result tee_ta_open_session(TEE_ErrorOrigin *err,
+static TEE_Result open_session(TEE_ErrorOrigin *err,
 			       struct tee_ta_session **sess,
 			       struct tee_ta_session_head *open_sessions,
 			       const TEE_UUID *uuid,
@@ -772,6 +1077,31 @@ TEE_Result tee_ta_open_session(TEE_ErrorOrigin *err,
 	return res;
 }
 
+TEE_Result tee_ta_open_session(TEE_ErrorOrigin *err,
+			       struct tee_ta_session **sess,
+			       struct tee_ta_session_head *open_sessions,
+			       const TEE_UUID *uuid,
+			       const TEE_Identity *clnt_id,
+			       uint32_t cancel_req_to,
+			       struct tee_ta_param *param)
+{
+	uint64_t start = barrier_read_counter_timer();
+	TEE_Result res = TEE_SUCCESS;
+	uint32_t exceptions = 0;
+	uint64_t ticks = 0;
+
+	res = open_session(err, sess, open_sessions, uuid, clnt_id,
+			   cancel_req_to, param);
+
+	ticks = barrier_read_counter_timer() - start;
+	exceptions = cpu_spin_lock_xsave(&open_stats_lock);
+	open_stats.count++;
+	open_stats.buckets[open_stats_bucket(ticks)]++;
+	cpu_spin_unlock_xrestore(&open_stats_lock, exceptions);
+
+	return res;
+}
+
 TEE_Result tee_ta_invoke_command(TEE_ErrorOrigin *err,
 				 struct tee_ta_session *sess,
 				 const TEE_Identity *clnt_id,
@@ -411,8 +411,8 @@ static TEE_Result check_ta_store(void)
 }
 service_init(check_ta_store);
 
-TEE_Result tee_ta_init_user_ta_session(const TEE_UUID *uuid,
-				       struct tee_ta_session *s)
+static TEE_Result init_user_ta_session(const TEE_UUID *uuid,
+				       struct tee_ta_session *s, bool idle)
 {
 	TEE_Result res = TEE_SUCCESS;
 	struct user_ta_ctx *utc = NULL;
@@ -427,7 +427,12 @@ TEE_Result tee_ta_init_user_ta_session(const TEE_UUID *uuid,
 	TAILQ_INIT(&utc->objects);
 	TAILQ_INIT(&utc->storage_enums);
 	condvar_init(&utc->ta_ctx.busy_cv);
-	utc->ta_ctx.ref_count = 1;
+	/*
+	 * An idle instance is only referenced once claimed by a session,
+	 * which can't happen before it's fully initialized.
+	 */
+	utc->ta_ctx.ref_count = !idle;
+	utc->ta_ctx.idle = idle;
 
 	utc->uctx.ts_ctx = &utc->ta_ctx.ts_ctx;
 
@@ -488,3 +493,15 @@ out:
 
 	return res;
 }
+
+TEE_Result tee_ta_init_user_ta_session(const TEE_UUID *uuid,
+				       struct tee_ta_session *s)
+{
+	return init_user_ta_session(uuid, s, false);
+}
+
+TEE_Result tee_ta_init_user_ta_idle(const TEE_UUID *uuid,
+				    struct tee_ta_session *s)
+{
+	return init_user_ta_session(uuid, s, true);
+}
@@ -3,6 +3,7 @@
  * Copyright (c) 2015-2021, Linaro Limited
  */
 
+#include <assert.h>
 #include <compiler.h>
 #include <kernel/notif.h>
 #include <kernel/spinlock.h>
@@ -13,9 +14,7 @@
 #include <tee_api_defines.h>
 #include <trace.h>
 #include <types_ext.h>
-
-static unsigned wq_spin_lock;
-
+#include <util.h>
 
 void wq_init(struct wait_queue *wq)
 {
@@ -40,18 +39,30 @@ static void do_notif(TEE_Result (*fn)(uint32_t), int id,
 		DMSG("%s thread %d res %#"PRIx32, cmd_str, id, res);
 }
 
-static void slist_add_tail(struct wait_queue *wq, struct wait_queue_elem *wqe)
+static void wq_add_tail(struct wait_queue *wq, struct wait_queue_elem *wqe)
 {
-	struct wait_queue_elem *wqe_iter;
-
-	/* Add elem to end of wait queue */
-	wqe_iter = SLIST_FIRST(wq);
-	if (wqe_iter) {
-		while (SLIST_NEXT(wqe_iter, link))
-			wqe_iter = SLIST_NEXT(wqe_iter, link);
-		SLIST_INSERT_AFTER(wqe_iter, wqe, link);
-	} else
-		SLIST_INSERT_HEAD(wq, wqe, link);
+	if (wq->tail)
+		SLIST_INSERT_AFTER(wq->tail, wqe, link);
+	else
+		SLIST_INSERT_HEAD(&wq->head, wqe, link);
+	wq->tail = wqe;
+}
+
+static void wq_remove(struct wait_queue *wq, struct wait_queue_elem *wqe)
+{
+	struct wait_queue_elem *prev = NULL;
+
+	if (SLIST_FIRST(&wq->head) == wqe) {
+		SLIST_REMOVE_HEAD(&wq->head, link);
+	} else {
+		prev = SLIST_FIRST(&wq->head);
+		while (SLIST_NEXT(prev, link) != wqe)
+			prev = SLIST_NEXT(prev, link);
+		SLIST_REMOVE_AFTER(prev, link);
+	}
+
+	if (wq->tail == wqe)
+		wq->tail = prev;
 }
 
 void wq_wait_init_condvar(struct wait_queue *wq, struct wait_queue_elem *wqe,
@@ -64,11 +75,13 @@ void wq_wait_init_condvar(struct wait_queue *wq, struct wait_queue_elem *wqe,
 	wqe->wait_read = wait_read;
 	wqe->cv = cv;
 
-	old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
+	old_itr_status = cpu_spin_lock_xsave(&wq->spin_lock);
 
-	slist_add_tail(wq, wqe);
+	wq_add_tail(wq, wqe);
+	if (wait_read && !cv)
+		wq->num_read_waiters++;
 
-	cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
+	cpu_spin_unlock_xrestore(&wq->spin_lock, old_itr_status);
 }
 
 void wq_wait_final(struct wait_queue *wq, struct wait_queue_elem *wqe,
@@ -81,64 +94,84 @@ void wq_wait_final(struct wait_queue *wq, struct wait_queue_elem *wqe,
 		do_notif(notif_wait, wqe->handle,
 			 "sleep", sync_obj, fname, lineno);
 
-		old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
+		old_itr_status = cpu_spin_lock_xsave(&wq->spin_lock);
 
 		done = wqe->done;
 		if (done)
-			SLIST_REMOVE(wq, wqe, wait_queue_elem, link);
+			wq_remove(wq, wqe);
 
-		cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
+		cpu_spin_unlock_xrestore(&wq->spin_lock, old_itr_status);
 	} while (!done);
 }
 
+void wq_wait_cancel(struct wait_queue *wq, struct wait_queue_elem *wqe)
+{
+	uint32_t old_itr_status = cpu_spin_lock_xsave(&wq->spin_lock);
+
+	/*
+	 * If the element was woken up in the meantime a notification may
+	 * be pending for this thread, the next wq_wait_final() will then
+	 * find its element not done and wait again.
+	 */
+	if (!wqe->done && wqe->wait_read && !wqe->cv) {
+		assert(wq->num_read_waiters);
+		wq->num_read_waiters--;
+	}
+	wq_remove(wq, wqe);
+
+	cpu_spin_unlock_xrestore(&wq->spin_lock, old_itr_status);
+}
+
 void wq_wake_next(struct wait_queue *wq, const void *sync_obj,
 			const char *fname, int lineno)
 {
 	uint32_t old_itr_status;
 	struct wait_queue_elem *wqe;
-	int handle = -1;
-	bool do_wakeup = false;
-	bool wake_type_assigned = false;
-	bool wake_read = false; /* avoid gcc warning */
+	/* A thread can only wait in one wait queue at a time */
+	short handles[CFG_NUM_THREADS];
+	size_t num_handles = 0;
+	bool wake_read = false;
+	size_t n = 0;
 
 	/*
 	 * If next type is wait_read wakeup all wqe with wait_read true.
 	 * If next type isn't wait_read wakeup only the first wqe which isn't
 	 * done.
+	 *
+	 * The wqes are marked done while holding the spinlock, but the
+	 * threads are notified after releasing it.
 	 */
 
-	while (true) {
-		old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
-
-		SLIST_FOREACH(wqe, wq, link) {
-			if (wqe->cv)
-				continue;
-			if (wqe->done)
-				continue;
-			if (!wake_type_assigned) {
-				wake_read = wqe->wait_read;
-				wake_type_assigned = true;
-			}
-
-			if (wqe->wait_read != wake_read)
-				continue;
-
-			wqe->done = true;
-			handle = wqe->handle;
-			do_wakeup = true;
-			break;
-		}
+	old_itr_status = cpu_spin_lock_xsave(&wq->spin_lock);
 
-		cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
+	SLIST_FOREACH(wqe, &wq->head, link) {
+		if (wqe->cv)
+			continue;
+		if (wqe->done)
+			continue;
+		if (!num_handles)
+			wake_read = wqe->wait_read;
+		else if (!wqe->wait_read)
+			continue;
 
-		if (do_wakeup)
-			do_notif(notif_send_sync, handle,
-				 "wake ", sync_obj, fname, lineno);
+		assert(num_handles < ARRAY_SIZE(handles));
+		wqe->done = true;
+		handles[num_handles] = wqe->handle;
+		num_handles++;
 
-		if (!do_wakeup || !wake_read)
+		if (!wake_read)
+			break;
+		assert(wq->num_read_waiters);
+		wq->num_read_waiters--;
+		if (!wq->num_read_waiters)
 			break;
-		do_wakeup = false;
 	}
+
+	cpu_spin_unlock_xrestore(&wq->spin_lock, old_itr_status);
+
+	for (n = 0; n < num_handles; n++)
+		do_notif(notif_send_sync, handles[n],
+			 "wake ", sync_obj, fname, lineno);
 }
 
 void wq_promote_condvar(struct wait_queue *wq, struct condvar *cv,
@@ -151,7 +184,7 @@ void wq_promote_condvar(struct wait_queue *wq, struct condvar *cv,
 	if (!cv)
 		return;
 
-	old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
+	old_itr_status = cpu_spin_lock_xsave(&wq->spin_lock);
 
 	/*
 	 * Find condvar waiter(s) and promote each to an active waiter.
@@ -159,7 +192,7 @@ void wq_promote_condvar(struct wait_queue *wq, struct condvar *cv,
 	 * condvar waiter is added to the queue when waiting for the
 	 * condvar.
 	 */
-	SLIST_FOREACH(wqe, wq, link) {
+	SLIST_FOREACH(wqe, &wq->head, link) {
 		if (wqe->cv == cv) {
 			if (fname)
 				FMSG("promote thread %u %p %s:%d",
@@ -169,12 +202,14 @@ void wq_promote_condvar(struct wait_queue *wq, struct condvar *cv,
 				     wqe->handle, (void *)cv->m);
 
 			wqe->cv = NULL;
+			if (wqe->wait_read)
+				wq->num_read_waiters++;
 			if (only_one)
 				break;
 		}
 	}
 
-	cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
+	cpu_spin_unlock_xrestore(&wq->spin_lock, old_itr_status);
 }
 
 bool wq_have_condvar(struct wait_queue *wq, struct condvar *cv)
@@ -183,16 +218,16 @@ bool wq_have_condvar(struct wait_queue *wq, struct condvar *cv)
 	struct wait_queue_elem *wqe;
 	bool rc = false;
 
-	old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
+	old_itr_status = cpu_spin_lock_xsave(&wq->spin_lock);
 
-	SLIST_FOREACH(wqe, wq, link) {
+	SLIST_FOREACH(wqe, &wq->head, link) {
 		if (wqe->cv == cv) {
 			rc = true;
 			break;
 		}
 	}
 
-	cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
+	cpu_spin_unlock_xrestore(&wq->spin_lock, old_itr_status);
 
 	return rc;
 }
@@ -202,11 +237,11 @@ bool wq_is_empty(struct wait_queue *wq)
 	uint32_t old_itr_status;
 	bool ret;
 
-	old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
+	old_itr_status = cpu_spin_lock_xsave(&wq->spin_lock);
 
-	ret = SLIST_EMPTY(wq);
+	ret = SLIST_EMPTY(&wq->head);
 
-	cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
+	cpu_spin_unlock_xrestore(&wq->spin_lock, old_itr_status);
 
 	return ret;
 }
@@ -13,8 +13,15 @@
 #include <types_ext.h>
 #include <util.h>
 
+/*
+ * struct file_slice_elem - file slice list element
+ * @slice:	The file slice
+ * @owner:	Identifies the loader which populated @slice
+ * @link:	Linked list element
+ */
 struct file_slice_elem {
 	struct file_slice slice;
+	unsigned int owner;
 	SLIST_ENTRY(file_slice_elem) link;
 };
 
@@ -26,6 +33,9 @@ struct file_slice_elem {
  * @link:	Linked list element
  * @num_slices:	Number of elements in the @slices array below
  * @slices:	Array of file slices holding the fobjs of this file
+ * @cached:	True if @file_cache holds a reference to this file, set
+ *		with both @mu and @file_mu held, cleared with @file_mu held
+ * @cache_link:	Linked list element in @file_cache
  *
  * A file is constructed of slices which may be shared in different
  * mappings/contexts. There may be holes in the file for ranges of the file
@@ -38,11 +48,18 @@ struct file {
 	TAILQ_ENTRY(file) link;
 	struct mutex mu;
 	SLIST_HEAD(, file_slice_elem) slice_head;
+	bool cached;
+	TAILQ_ENTRY(file) cache_link;
 };
 
 static struct mutex file_mu = MUTEX_INITIALIZER;
 static TAILQ_HEAD(, file) file_head = TAILQ_HEAD_INITIALIZER(file_head);
 
+/* Verified files, most recently used first. Protected by @file_mu */
+static TAILQ_HEAD(file_cache_head, file) file_cache =
+	TAILQ_HEAD_INITIALIZER(file_cache);
+static size_t file_cache_count;
+
 static int file_tag_cmp(const struct file *f, const uint8_t *tag,
 			unsigned int taglen)
 {
@@ -79,10 +96,11 @@ static void file_free(struct file *f)
 }
 
 TEE_Result file_add_slice(struct file *f, struct fobj *fobj,
-			  unsigned int page_offset)
+			  unsigned int page_offset, unsigned int owner)
 {
 	struct file_slice_elem *fse = NULL;
 	unsigned int s = 0;
+	bool cached = false;
 
 	/* Check for conflicts */
 	if (file_find_slice(f, page_offset))
@@ -101,7 +119,23 @@ TEE_Result file_add_slice(struct file *f, struct fobj *fobj,
 	}
 
 	fse->slice.page_offset = page_offset;
-	SLIST_INSERT_HEAD(&f->slice_head, fse, link);
+	fse->owner = owner;
+
+	/*
+	 * @f->mu is held by the caller so file_set_verified() can't cache
+	 * the file until the slice is inserted.
+	 */
+	mutex_lock(&file_mu);
+	cached = f->cached;
+	if (!cached)
+		SLIST_INSERT_HEAD(&f->slice_head, fse, link);
+	mutex_unlock(&file_mu);
+
+	if (cached) {
+		fobj_put(fse->slice.fobj);
+		free(fse);
+		return TEE_ERROR_BAD_STATE;
+	}
 
 	return TEE_SUCCESS;
 }
@@ -145,8 +179,13 @@ struct file *file_get_by_tag(const uint8_t *tag, unsigned int taglen)
 	 * possibly hiding a case of mismatching file_put() and file_get().
 	 */
 	f = file_find_tag_unlocked(tag, taglen);
-	if (f && refcount_inc(&f->refc))
+	if (f && refcount_inc(&f->refc)) {
+		if (f->cached) {
+			TAILQ_REMOVE(&file_cache, f, cache_link);
+			TAILQ_INSERT_HEAD(&file_cache, f, cache_link);
+		}
 		goto out;
+	}
 
 	f = calloc(1, sizeof(*f));
 	if (!f)
@@ -176,6 +215,85 @@ void file_put(struct file *f)
 
 }
 
+static bool file_slices_owned_by(struct file *f, unsigned int owner)
+{
+	struct file_slice_elem *fse = NULL;
+
+	if (SLIST_EMPTY(&f->slice_head))
+		return false;
+
+	SLIST_FOREACH(fse, &f->slice_head, link)
+		if (fse->owner != owner)
+			return false;
+
+	return true;
+}
+
+void file_set_verified(struct file *f, unsigned int owner)
+{
+	struct file *evict = NULL;
+
+	if (!CFG_CORE_FILE_CACHE_ENTRIES)
+		return;
+
+	assert(f->mu.state);
+	mutex_lock(&file_mu);
+
+	if (f->cached) {
+		TAILQ_REMOVE(&file_cache, f, cache_link);
+	} else {
+		/*
+		 * Slices populated by another loader may come from a
+		 * binary that hasn't been, or never will be, verified.
+		 */
+		if (!file_slices_owned_by(f, owner))
+			goto out;
+
+		file_get(f);
+		f->cached = true;
+		file_cache_count++;
+		if (file_cache_count > CFG_CORE_FILE_CACHE_ENTRIES) {
+			evict = TAILQ_LAST(&file_cache, file_cache_head);
+			TAILQ_REMOVE(&file_cache, evict, cache_link);
+			evict->cached = false;
+			file_cache_count--;
+		}
+	}
+	TAILQ_INSERT_HEAD(&file_cache, f, cache_link);
+
+out:
+	mutex_unlock(&file_mu);
+
+	/* Takes file_mu if it's the last reference */
+	file_put(evict);
+}
+
+void file_cache_drop_unused(void)
+{
+	struct file *f = NULL;
+
+	while (true) {
+		mutex_lock(&file_mu);
+		/*
+		 * A file with only the cache reference can't be found by
+		 * anyone else while file_mu is held.
+		 */
+		TAILQ_FOREACH(f, &file_cache, cache_link)
+			if (refcount_val(&f->refc) == 1)
+				break;
+		if (f) {
+			TAILQ_REMOVE(&file_cache, f, cache_link);
+			f->cached = false;
+			file_cache_count--;
+		}
+		mutex_unlock(&file_mu);
+
+		if (!f)
+			return;
+		file_put(f);
+	}
+}
+
 struct file_slice *file_find_slice(struct file *f, unsigned int page_offset)
 {
 	struct file_slice_elem *fse = NULL;
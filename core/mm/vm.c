@@ -46,6 +46,94 @@
 #define TEE_MMU_UCACHE_DEFAULT_ATTR	(TEE_MATTR_CACHE_CACHED << \
 					 TEE_MATTR_CACHE_SHIFT)
 
+/*
+ * The regions of a vm_info are kept in a TAILQ sorted on va, which is
+ * convenient when adding, splitting and merging regions. Lookups by
+ * address are done with a binary search in vmi->region_index instead.
+ * The index is invalidated with invalidate_region_index() each time the
+ * list or the va range of a region is changed and rebuilt with
+ * update_region_index() once the operation is complete. Lookups fall
+ * back to scanning the list while the index is invalid.
+ */
+static void invalidate_region_index(struct vm_info *vmi)
+{
+	vmi->region_index_valid = false;
+}
+
+static void update_region_index(struct vm_info *vmi)
+{
+	struct vm_region *r = NULL;
+	size_t n = 0;
+
+	if (vmi->region_index_valid)
+		return;
+
+	TAILQ_FOREACH(r, &vmi->regions, link)
+		n++;
+
+	if (n > vmi->region_index_alloc) {
+		size_t alloc = ROUNDUP(n, 8);
+		struct vm_region **p = NULL;
+
+		p = realloc(vmi->region_index, alloc * sizeof(*p));
+		if (!p)
+			return;
+		vmi->region_index = p;
+		vmi->region_index_alloc = alloc;
+	}
+
+	n = 0;
+	TAILQ_FOREACH(r, &vmi->regions, link)
+		vmi->region_index[n++] = r;
+	vmi->region_index_count = n;
+	vmi->region_index_valid = true;
+}
+
+/*
+ * Returns the index of the first region in vmi->region_index which ends
+ * after @va, or vmi->region_index_count if there's no such region.
+ */
+static size_t region_index_lower_bound(const struct vm_info *vmi, vaddr_t va)
+{
+	size_t lo = 0;
+	size_t hi = vmi->region_index_count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		struct vm_region *r = vmi->region_index[mid];
+
+		if (r->va + r->size - 1 < va)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static struct vm_region *find_vm_region(const struct vm_info *vmi,
+					vaddr_t va)
+{
+	struct vm_region *r = NULL;
+	size_t n = 0;
+
+	if (vmi->region_index_valid) {
+		n = region_index_lower_bound(vmi, va);
+		if (n == vmi->region_index_count)
+			return NULL;
+		r = vmi->region_index[n];
+		if (va >= r->va)
+			return r;
+		return NULL;
+	}
+
+	TAILQ_FOREACH(r, &vmi->regions, link)
+		if (va >= r->va && va < r->va + r->size)
+			return r;
+
+	return NULL;
+}
+
 static vaddr_t select_va_in_range(const struct vm_region *prev_reg,
 				  const struct vm_region *next_reg,
 				  const struct vm_region *reg,
@@ -156,20 +244,26 @@ static TEE_Result alloc_pgt(struct user_mode_ctx *uctx)
 		 * The supplied utc is the current active utc, allocate the
 		 * page tables too as the pager needs to use them soon.
 		 */
-		pgt_alloc(&tsd->pgt_cache, uctx->ts_ctx, b, e - 1);
+		pgt_alloc(&tsd->pgt_cache, uctx->ts_ctx, b, e - 1, NULL,
+			  NULL);
 	}
 #endif
 
 	return TEE_SUCCESS;
 }
 
-static void rem_um_region(struct user_mode_ctx *uctx, struct vm_region *r)
+/*
+ * Returns true if the active user mapping has to be rebuilt with
+ * vm_set_ctx() once @r is removed from the VM regions.
+ */
+static bool rem_um_region(struct user_mode_ctx *uctx, struct vm_region *r)
 {
 	struct thread_specific_data *tsd = thread_get_tsd();
 	struct pgt_cache *pgt_cache = NULL;
 	vaddr_t begin = ROUNDDOWN(r->va, CORE_MMU_PGDIR_SIZE);
 	vaddr_t last = ROUNDUP(r->va + r->size, CORE_MMU_PGDIR_SIZE);
 	struct vm_region *r2 = NULL;
+	bool rebuild = false;
 
 	if (uctx->ts_ctx == tsd->ctx)
 		pgt_cache = &tsd->pgt_cache;
@@ -179,6 +273,14 @@ static void rem_um_region(struct user_mode_ctx *uctx, struct vm_region *r)
 	} else {
 		pgt_clear_ctx_range(pgt_cache, uctx->ts_ctx, r->va,
 				    r->va + r->size);
+		/*
+		 * Block mapped parts of the region are in the directory
+		 * table which is only rebuilt by vm_set_ctx(). Whole blocks
+		 * intersecting the region are cleared before the TLB is
+		 * flushed, what remains of them is mapped again with page
+		 * tables when the caller rebuilds the mapping.
+		 */
+		rebuild = core_mmu_clear_user_blocks(r->va, r->size);
 		tlbi_mva_range_asid(r->va, r->size, SMALL_PAGE_SIZE,
 				    uctx->vm_info.asid);
 	}
@@ -193,10 +295,17 @@ static void rem_um_region(struct user_mode_ctx *uctx, struct vm_region *r)
 			    ROUNDUP(r2->va + r2->size, CORE_MMU_PGDIR_SIZE));
 
 	/* If there's no unused page tables, there's nothing left to do */
-	if (begin >= last)
-		return;
+	if (begin < last)
+		pgt_flush_ctx_range(pgt_cache, uctx->ts_ctx, r->va,
+				    r->va + r->size);
 
-	pgt_flush_ctx_range(pgt_cache, uctx->ts_ctx, r->va, r->va + r->size);
+	return rebuild;
+}
+
+/* Rebuilds the active user mapping after a block was cleared */
+static void rebuild_user_map(void)
+{
+	vm_set_ctx(thread_get_tsd()->ctx);
 }
 
 static TEE_Result umap_add_region(struct vm_info *vmi, struct vm_region *reg,
@@ -238,6 +347,7 @@ static TEE_Result umap_add_region(struct vm_info *vmi, struct vm_region *reg,
 		if (va) {
 			reg->va = va;
 			TAILQ_INSERT_BEFORE(r, reg, link);
+			invalidate_region_index(vmi);
 			return TEE_SUCCESS;
 		}
 		prev_r = r;
@@ -251,12 +361,26 @@ static TEE_Result umap_add_region(struct vm_info *vmi, struct vm_region *reg,
 	if (va) {
 		reg->va = va;
 		TAILQ_INSERT_TAIL(&vmi->regions, reg, link);
+		invalidate_region_index(vmi);
 		return TEE_SUCCESS;
 	}
 
 	return TEE_ERROR_ACCESS_CONFLICT;
 }
 
+static bool pgdir_aligned_pa(struct mobj *mobj, size_t offs, size_t size)
+{
+	paddr_t pa = 0;
+
+	if (mobj_is_paged(mobj) || mobj->phys_granule ||
+	    size < CORE_MMU_PGDIR_SIZE)
+		return false;
+	if (mobj_get_pa(mobj, offs, 0, &pa))
+		return false;
+
+	return !(pa & CORE_MMU_PGDIR_MASK);
+}
+
 TEE_Result vm_map_pad(struct user_mode_ctx *uctx, vaddr_t *va, size_t len,
 		      uint32_t prot, uint32_t flags, struct mobj *mobj,
 		      size_t offs, size_t pad_begin, size_t pad_end,
@@ -292,7 +416,19 @@ TEE_Result vm_map_pad(struct user_mode_ctx *uctx, vaddr_t *va, size_t len,
 	reg->attr = attr | prot;
 	reg->flags = flags;
 
-	res = umap_add_region(&uctx->vm_info, reg, pad_begin, pad_end, align);
+	/*
+	 * Try to place large physically contiguous mappings so they can be
+	 * mapped with block descriptors, see can_map_pg_block(). Fall back
+	 * to the requested alignment if there's no room for that.
+	 */
+	res = TEE_ERROR_ACCESS_CONFLICT;
+	if (!reg->va && align < CORE_MMU_PGDIR_SIZE &&
+	    pgdir_aligned_pa(mobj, offs, reg->size))
+		res = umap_add_region(&uctx->vm_info, reg, pad_begin, pad_end,
+				      CORE_MMU_PGDIR_SIZE);
+	if (res)
+		res = umap_add_region(&uctx->vm_info, reg, pad_begin, pad_end,
+				      align);
 	if (res)
 		goto err_put_mobj;
 
@@ -322,11 +458,14 @@ TEE_Result vm_map_pad(struct user_mode_ctx *uctx, vaddr_t *va, size_t len,
 		vm_set_ctx(uctx->ts_ctx);
 
 	*va = reg->va;
+	update_region_index(&uctx->vm_info);
 
 	return TEE_SUCCESS;
 
 err_rem_reg:
 	TAILQ_REMOVE(&uctx->vm_info.regions, reg, link);
+	invalidate_region_index(&uctx->vm_info);
+	update_region_index(&uctx->vm_info);
 err_put_mobj:
 	mobj_put(reg->mobj);
 err_free_reg:
@@ -334,17 +473,6 @@ err_free_reg:
 	return res;
 }
 
-static struct vm_region *find_vm_region(struct vm_info *vm_info, vaddr_t va)
-{
-	struct vm_region *r = NULL;
-
-	TAILQ_FOREACH(r, &vm_info->regions, link)
-		if (va >= r->va && va < r->va + r->size)
-			return r;
-
-	return NULL;
-}
-
 static bool va_range_is_contiguous(struct vm_region *r0, vaddr_t va,
 				   size_t len,
 				   bool (*cmp_regs)(const struct vm_region *r0,
@@ -404,6 +532,7 @@ static TEE_Result split_vm_region(struct user_mode_ctx *uctx,
 	r->size = diff;
 
 	TAILQ_INSERT_AFTER(&uctx->vm_info.regions, r, r2, link);
+	invalidate_region_index(&uctx->vm_info);
 
 	return TEE_SUCCESS;
 }
@@ -495,6 +624,7 @@ static void merge_vm_range(struct user_mode_ctx *uctx, vaddr_t va, size_t len)
 			continue;
 
 		TAILQ_REMOVE(&uctx->vm_info.regions, r_next, link);
+		invalidate_region_index(&uctx->vm_info);
 		r->size += r_next->size;
 		mobj_put(r_next->mobj);
 		free(r_next);
@@ -551,6 +681,7 @@ TEE_Result vm_remap(struct user_mode_ctx *uctx, vaddr_t *new_va, vaddr_t old_va,
 		r_next = TAILQ_NEXT(r, link);
 		rem_um_region(uctx, r);
 		TAILQ_REMOVE(&uctx->vm_info.regions, r, link);
+		invalidate_region_index(&uctx->vm_info);
 		TAILQ_INSERT_TAIL(&regs, r, link);
 	}
 
@@ -598,6 +729,7 @@ TEE_Result vm_remap(struct user_mode_ctx *uctx, vaddr_t *new_va, vaddr_t old_va,
 			for (r = r_first; r_last && r != r_last; r = r_next) {
 				r_next = TAILQ_NEXT(r, link);
 				TAILQ_REMOVE(&uctx->vm_info.regions, r, link);
+				invalidate_region_index(&uctx->vm_info);
 				if (r_tmp)
 					TAILQ_INSERT_AFTER(&regs, r_tmp, r,
 							   link);
@@ -614,6 +746,7 @@ TEE_Result vm_remap(struct user_mode_ctx *uctx, vaddr_t *new_va, vaddr_t old_va,
 
 	vm_set_ctx(uctx->ts_ctx);
 	*new_va = r_first->va;
+	update_region_index(&uctx->vm_info);
 
 	return TEE_SUCCESS;
 
@@ -633,6 +766,7 @@ err_restore_map:
 	}
 	fobj_put(fobj);
 	vm_set_ctx(uctx->ts_ctx);
+	update_region_index(&uctx->vm_info);
 
 	return res;
 }
@@ -745,6 +879,7 @@ TEE_Result vm_set_prot(struct user_mode_ctx *uctx, vaddr_t va, size_t len,
 		cache_op_inner(ICACHE_INVALIDATE, NULL, 0);
 
 	merge_vm_range(uctx, va, len);
+	update_region_index(&uctx->vm_info);
 
 	return TEE_SUCCESS;
 }
@@ -752,6 +887,7 @@ TEE_Result vm_set_prot(struct user_mode_ctx *uctx, vaddr_t va, size_t len,
 static void umap_remove_region(struct vm_info *vmi, struct vm_region *reg)
 {
 	TAILQ_REMOVE(&vmi->regions, reg, link);
+	invalidate_region_index(vmi);
 	mobj_put(reg->mobj);
 	free(reg);
 }
@@ -763,6 +899,7 @@ TEE_Result vm_unmap(struct user_mode_ctx *uctx, vaddr_t va, size_t len)
 	struct vm_region *r_next = NULL;
 	size_t end_va = 0;
 	size_t unmap_end_va = 0;
+	bool rebuild = false;
 	size_t l = 0;
 
 	assert(thread_get_tsd()->ctx == uctx->ts_ctx);
@@ -783,12 +920,15 @@ TEE_Result vm_unmap(struct user_mode_ctx *uctx, vaddr_t va, size_t len)
 	while (true) {
 		r_next = TAILQ_NEXT(r, link);
 		unmap_end_va = r->va + r->size;
-		rem_um_region(uctx, r);
+		rebuild |= rem_um_region(uctx, r);
 		umap_remove_region(&uctx->vm_info, r);
 		if (!r_next || unmap_end_va == end_va)
 			break;
 		r = r_next;
 	}
+	update_region_index(&uctx->vm_info);
+	if (rebuild)
+		rebuild_user_map();
 
 	return TEE_SUCCESS;
 }
@@ -845,13 +985,17 @@ void vm_clean_param(struct user_mode_ctx *uctx)
 {
 	struct vm_region *next_r;
 	struct vm_region *r;
+	bool rebuild = false;
 
 	TAILQ_FOREACH_SAFE(r, &uctx->vm_info.regions, link, next_r) {
 		if (r->flags & VM_FLAG_EPHEMERAL) {
-			rem_um_region(uctx, r);
+			rebuild |= rem_um_region(uctx, r);
 			umap_remove_region(&uctx->vm_info, r);
 		}
 	}
+	update_region_index(&uctx->vm_info);
+	if (rebuild)
+		rebuild_user_map();
 }
 
 static void check_param_map_empty(struct user_mode_ctx *uctx __maybe_unused)
@@ -1048,6 +1192,7 @@ TEE_Result vm_add_rwmem(struct user_mode_ctx *uctx, struct mobj *mobj,
 		umap_remove_region(&uctx->vm_info, reg);
 	else
 		*va = reg->va;
+	update_region_index(&uctx->vm_info);
 
 	return res;
 }
@@ -1058,8 +1203,12 @@ void vm_rem_rwmem(struct user_mode_ctx *uctx, struct mobj *mobj, vaddr_t va)
 
 	TAILQ_FOREACH(r, &uctx->vm_info.regions, link) {
 		if (r->mobj == mobj && r->va == va) {
-			rem_um_region(uctx, r);
+			bool rebuild = rem_um_region(uctx, r);
+
 			umap_remove_region(&uctx->vm_info, r);
+			update_region_index(&uctx->vm_info);
+			if (rebuild)
+				rebuild_user_map();
 			return;
 		}
 	}
@@ -1077,6 +1226,7 @@ void vm_info_final(struct user_mode_ctx *uctx)
 	while (!TAILQ_EMPTY(&uctx->vm_info.regions))
 		umap_remove_region(&uctx->vm_info,
 				   TAILQ_FIRST(&uctx->vm_info.regions));
+	free(uctx->vm_info.region_index);
 	memset(&uctx->vm_info, 0, sizeof(uctx->vm_info));
 }
 
@@ -1084,16 +1234,13 @@ void vm_info_final(struct user_mode_ctx *uctx)
 bool vm_buf_is_inside_um_private(const struct user_mode_ctx *uctx,
 				 const void *va, size_t size)
 {
-	struct vm_region *r = NULL;
+	struct vm_region *r = find_vm_region(&uctx->vm_info, (vaddr_t)va);
 
-	TAILQ_FOREACH(r, &uctx->vm_info.regions, link) {
-		if (r->flags & VM_FLAGS_NONPRIV)
-			continue;
-		if (core_is_buffer_inside((vaddr_t)va, size, r->va, r->size))
-			return true;
-	}
+	/* Regions don't overlap so only the one holding va can match */
+	if (!r || (r->flags & VM_FLAGS_NONPRIV))
+		return false;
 
-	return false;
+	return core_is_buffer_inside((vaddr_t)va, size, r->va, r->size);
 }
 
 /* return true only if buffer intersects TA private memory */
@@ -1116,69 +1263,58 @@ TEE_Result vm_buf_to_mboj_offs(const struct user_mode_ctx *uctx,
 			       const void *va, size_t size,
 			       struct mobj **mobj, size_t *offs)
 {
-	struct vm_region *r = NULL;
-
-	TAILQ_FOREACH(r, &uctx->vm_info.regions, link) {
-		if (!r->mobj)
-			continue;
-		if (core_is_buffer_inside((vaddr_t)va, size, r->va, r->size)) {
-			size_t poffs;
+	struct vm_region *r = find_vm_region(&uctx->vm_info, (vaddr_t)va);
+	size_t poffs = 0;
 
-			poffs = mobj_get_phys_offs(r->mobj,
-						   CORE_MMU_USER_PARAM_SIZE);
-			*mobj = r->mobj;
-			*offs = (vaddr_t)va - r->va + r->offset - poffs;
-			return TEE_SUCCESS;
-		}
-	}
+	if (!r || !r->mobj ||
+	    !core_is_buffer_inside((vaddr_t)va, size, r->va, r->size))
+		return TEE_ERROR_BAD_PARAMETERS;
 
-	return TEE_ERROR_BAD_PARAMETERS;
+	poffs = mobj_get_phys_offs(r->mobj, CORE_MMU_USER_PARAM_SIZE);
+	*mobj = r->mobj;
+	*offs = (vaddr_t)va - r->va + r->offset - poffs;
+	return TEE_SUCCESS;
 }
 
 static TEE_Result tee_mmu_user_va2pa_attr(const struct user_mode_ctx *uctx,
 					  void *ua, paddr_t *pa, uint32_t *attr)
 {
-	struct vm_region *region = NULL;
-
-	TAILQ_FOREACH(region, &uctx->vm_info.regions, link) {
-		if (!core_is_buffer_inside((vaddr_t)ua, 1, region->va,
-					   region->size))
-			continue;
+	struct vm_region *region = find_vm_region(&uctx->vm_info, (vaddr_t)ua);
 
-		if (pa) {
-			TEE_Result res;
-			paddr_t p;
-			size_t offset;
-			size_t granule;
+	if (!region)
+		return TEE_ERROR_ACCESS_DENIED;
 
-			/*
-			 * mobj and input user address may each include
-			 * a specific offset-in-granule position.
-			 * Drop both to get target physical page base
-			 * address then apply only user address
-			 * offset-in-granule.
-			 * Mapping lowest granule is the small page.
-			 */
-			granule = MAX(region->mobj->phys_granule,
-				      (size_t)SMALL_PAGE_SIZE);
-			assert(!granule || IS_POWER_OF_TWO(granule));
+	if (pa) {
+		TEE_Result res;
+		paddr_t p;
+		size_t offset;
+		size_t granule;
 
-			offset = region->offset +
-				 ROUNDDOWN((vaddr_t)ua - region->va, granule);
+		/*
+		 * mobj and input user address may each include
+		 * a specific offset-in-granule position.
+		 * Drop both to get target physical page base
+		 * address then apply only user address
+		 * offset-in-granule.
+		 * Mapping lowest granule is the small page.
+		 */
+		granule = MAX(region->mobj->phys_granule,
+			      (size_t)SMALL_PAGE_SIZE);
+		assert(!granule || IS_POWER_OF_TWO(granule));
 
-			res = mobj_get_pa(region->mobj, offset, granule, &p);
-			if (res != TEE_SUCCESS)
-				return res;
+		offset = region->offset +
+			 ROUNDDOWN((vaddr_t)ua - region->va, granule);
 
-			*pa = p | ((vaddr_t)ua & (granule - 1));
-		}
-		if (attr)
-			*attr = region->attr;
+		res = mobj_get_pa(region->mobj, offset, granule, &p);
+		if (res != TEE_SUCCESS)
+			return res;
 
-		return TEE_SUCCESS;
+		*pa = p | ((vaddr_t)ua & (granule - 1));
 	}
+	if (attr)
+		*attr = region->attr;
 
-	return TEE_ERROR_ACCESS_DENIED;
+	return TEE_SUCCESS;
 }
 
 TEE_Result vm_va2pa(const struct user_mode_ctx *uctx, void *ua, paddr_t *pa)
@@ -3,7 +3,10 @@
  * Copyright (c) 2017, Linaro Limited
  */
 
+#include <config.h>
 #include <kernel/pseudo_ta.h>
+#include <kernel/ree_fs_ta.h>
+#include <kernel/tee_ta_manager.h>
 #include <tee/tadb.h>
 #include <pta_secstor_ta_mgmt.h>
 #include <signed_hdr.h>
@@ -48,8 +51,14 @@ static TEE_Result install_ta(struct shdr *shdr, const uint8_t *nw,
 	void *buf;
 	struct tee_tadb_property property;
 	struct shdr_bootstrap_ta bs_ta;
-
-	if (shdr->img_type != SHDR_BOOTSTRAP_TA)
+	struct tee_tadb_compressed_custom custom = {
+		.magic = TEE_TADB_COMPRESSED_MAGIC,
+	};
+	struct shdr_compressed_ta *chdr = &custom.chdr;
+
+	if (shdr->img_type != SHDR_BOOTSTRAP_TA &&
+	    (shdr->img_type != SHDR_COMPRESSED_TA ||
+	     !IS_ENABLED(CFG_TA_COMPRESSED_IMAGES)))
 		return TEE_ERROR_SECURITY;
 
 	if (nw_size < (sizeof(struct shdr_bootstrap_ta) + SHDR_GET_SIZE(shdr)))
@@ -91,10 +100,33 @@ static TEE_Result install_ta(struct shdr *shdr, const uint8_t *nw,
 	offs += sizeof(bs_ta);
 
 	memset(&property, 0, sizeof(property));
+
+	if (shdr->img_type == SHDR_COMPRESSED_TA) {
+		if (nw_size - offs < sizeof(*chdr)) {
+			res = TEE_ERROR_SECURITY;
+			goto err_free_hash_ctx;
+		}
+		memcpy(chdr, nw + offs, sizeof(*chdr));
+		if (chdr->comp_algo != SHDR_COMP_ALGO_ZLIB) {
+			res = TEE_ERROR_NOT_SUPPORTED;
+			goto err_free_hash_ctx;
+		}
+		res = crypto_hash_update(hash_ctx, (uint8_t *)chdr,
+					 sizeof(*chdr));
+		if (res)
+			goto err_free_hash_ctx;
+		offs += sizeof(*chdr);
+
+		/*
+		 * The binary is stored compressed, the compression header
+		 * goes in the custom properties, see secstor_ta_open().
+		 */
+		property.custom_size = sizeof(custom);
+	}
+
 	COMPILE_TIME_ASSERT(sizeof(property.uuid) == sizeof(bs_ta.uuid));
 	tee_uuid_from_octets(&property.uuid, bs_ta.uuid);
 	property.version = bs_ta.ta_version;
-	property.custom_size = 0;
 	property.bin_size = nw_size - offs;
 	DMSG("Installing %pUl", (void *)&property.uuid);
 
@@ -102,6 +134,12 @@ static TEE_Result install_ta(struct shdr *shdr, const uint8_t *nw,
 	if (res)
 		goto err_free_hash_ctx;
 
+	if (property.custom_size) {
+		res = tee_tadb_ta_write(ta, &custom, sizeof(custom));
+		if (res)
+			goto err_ta_finalize;
+	}
+
 	while (offs < nw_size) {
 		size_t l = MIN(buf_size, nw_size - offs);
 
@@ -125,7 +163,12 @@ static TEE_Result install_ta(struct shdr *shdr, const uint8_t *nw,
 
 	crypto_hash_free_ctx(hash_ctx);
 	free(buf);
-	return tee_tadb_ta_close_and_commit(ta);
+	res = tee_tadb_ta_close_and_commit(ta);
+	if (!res) {
+		ree_fs_ta_cache_invalidate(&property.uuid);
+		tee_ta_idle_pool_invalidate(&property.uuid);
+	}
+	return res;
 
 err_ta_finalize:
 	tee_tadb_ta_close_and_delete(ta);
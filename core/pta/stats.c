@@ -3,9 +3,17 @@
  * Copyright (c) 2015, Linaro Limited
  */
 #include <compiler.h>
+#include <config.h>
 #include <stdio.h>
 #include <trace.h>
+#include <kernel/call_stats.h>
+#include <kernel/lockdep.h>
+#include <kernel/mutex.h>
 #include <kernel/pseudo_ta.h>
+#include <kernel/ree_fs_ta.h>
+#include <kernel/spinlock.h>
+#include <kernel/tee_ta_manager.h>
+#include <kernel/thread.h>
 #include <mm/tee_pager.h>
 #include <mm/tee_mm.h>
 #include <string.h>
@@ -21,6 +29,14 @@
 #define STATS_CMD_PAGER_STATS		0
 #define STATS_CMD_ALLOC_STATS		1
 #define STATS_CMD_MEMLEAK_STATS		2
+#define STATS_CMD_MUTEX_STATS		3
+#define STATS_CMD_SPINLOCK_STATS	4
+#define STATS_CMD_RPC_SHM_STATS		5
+#define STATS_CMD_THREAD_STATS		6
+#define STATS_CMD_CALL_STATS		7
+#define STATS_CMD_LOCK_PROFILE		8
+#define STATS_CMD_TA_CACHE_STATS	9
+#define STATS_CMD_TA_OPEN_STATS		10
 
 #define STATS_NB_POOLS			4
 
@@ -137,6 +153,221 @@ static TEE_Result get_memleak_stats(uint32_t type,
 	return TEE_SUCCESS;
 }
 
+static TEE_Result get_mutex_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct mutex_spin_stats stats = { };
+
+	/*
+	 * p[0].value.a = 0 if no reset of the stats
+	 * p[1].value.a = number of times a locker spun on a held mutex
+	 * p[1].value.b = number of spins which ended with the mutex acquired
+	 * p[2].value.a = number of times a locker slept in normal world
+	 */
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_NONE) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	mutex_get_spin_stats(&stats, p[0].value.a);
+	p[1].value.a = stats.spins;
+	p[1].value.b = stats.spin_acquired;
+	p[2].value.a = stats.sleeps;
+	p[2].value.b = 0;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result get_spinlock_stats(uint32_t type,
+				     TEE_Param p[TEE_NUM_PARAMS] __unused)
+{
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE,
+			    TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (!IS_ENABLED(CFG_TEE_CORE_DEBUG))
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	spinlock_dump_contention();
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result get_rpc_shm_stats(uint32_t type,
+				    TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct thread_shm_cache_stats stats = { };
+
+	/*
+	 * p[0].value.a = 0 if no reset of the stats
+	 * p[1].value.a = cache hits
+	 * p[1].value.b = cache misses
+	 * p[2].value.a = buffers evicted to make room for another size
+	 * p[2].value.b = buffers released after being idle
+	 */
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_NONE) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	thread_rpc_shm_cache_get_stats(&stats, p[0].value.a);
+	p[1].value.a = stats.hits;
+	p[1].value.b = stats.misses;
+	p[2].value.a = stats.evictions;
+	p[2].value.b = stats.trims;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result get_thread_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct thread_alloc_stats stats = { };
+
+	/*
+	 * p[0].value.a = 0 if no reset of the stats
+	 * p[1].value.a = calls started on a thread last run on the same core
+	 * p[1].value.b = calls started on a thread last run on another core
+	 */
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_NONE,
+			    TEE_PARAM_TYPE_NONE) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	thread_get_alloc_stats(&stats, p[0].value.a);
+	p[1].value.a = stats.warm;
+	p[1].value.b = stats.cold;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result get_call_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct call_stats_hist *hist = p[1].memref.buffer;
+	size_t num_cmds = 0;
+	size_t sz = 0;
+	size_t n = 0;
+
+	/*
+	 * p[0].value.a = class, 0 for OPTEE_MSG commands, 1 for RPC commands,
+	 *   2 for fast calls indexed by SMC function number
+	 * p[0].value.b = 0 if no reset of the stats
+	 * p[1].memref.buffer = output buffer to an array of
+	 *   struct call_stats_hist indexed by [core][command]
+	 * p[2].value.a = number of cores
+	 * p[2].value.b = number of commands per core
+	 */
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+			    TEE_PARAM_TYPE_MEMREF_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_NONE) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (!IS_ENABLED(CFG_CORE_CALL_STATS))
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	if (p[0].value.a != CALL_STATS_MSG && p[0].value.a != CALL_STATS_RPC &&
+	    p[0].value.a != CALL_STATS_FAST)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	num_cmds = call_stats_num_cmds(p[0].value.a);
+	p[2].value.a = CFG_TEE_CORE_NB_CORE;
+	p[2].value.b = num_cmds;
+
+	sz = CFG_TEE_CORE_NB_CORE * num_cmds * sizeof(*hist);
+	if (p[1].memref.size < sz) {
+		p[1].memref.size = sz;
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+	p[1].memref.size = sz;
+
+	for (n = 0; n < CFG_TEE_CORE_NB_CORE; n++)
+		call_stats_get(p[0].value.a, n, hist + n * num_cmds);
+
+	if (p[0].value.b)
+		call_stats_reset();
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result get_lock_profile(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	/*
+	 * p[0].value.a = 0 if no reset of the stats
+	 *
+	 * The profile is printed on the secure console.
+	 */
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT, TEE_PARAM_TYPE_NONE,
+			    TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (!IS_ENABLED(CFG_LOCKDEP_PROFILE))
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	mutex_lockdep_print_profile(p[0].value.a);
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result get_ta_cache_stats(uint32_t type,
+				     TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct ree_fs_ta_cache_stats stats = { };
+
+	/*
+	 * p[0].value.a = 0 if no reset of the stats
+	 * p[1].value.a = opens served from the verified TA image cache
+	 * p[1].value.b = opens which loaded and verified the TA image
+	 * p[2].value.a = images evicted to make room for another one
+	 * p[2].value.b = images dropped by a TA install or version update
+	 */
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_NONE) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	ree_fs_ta_cache_get_stats(&stats, p[0].value.a);
+	p[1].value.a = stats.hits;
+	p[1].value.b = stats.misses;
+	p[2].value.a = stats.evictions;
+	p[2].value.b = stats.invalidations;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result get_ta_open_stats(uint32_t type,
+				    TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct tee_ta_open_stats stats = { };
+
+	/*
+	 * p[0].value.a = 0 if no reset of the stats
+	 * p[1].value.a = number of opened sessions
+	 * p[1].value.b = opens which reused an idle TA instance
+	 * p[2].value.a = median open latency in microseconds
+	 * p[2].value.b = 90th percentile of the open latency in microseconds
+	 * p[3].value.a = 99th percentile of the open latency in microseconds
+	 * p[3].value.b = idle TA instances evicted
+	 */
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	tee_ta_get_open_stats(&stats, p[0].value.a);
+	p[1].value.a = stats.count;
+	p[1].value.b = stats.idle_hits;
+	p[2].value.a = stats.p50_us;
+	p[2].value.b = stats.p90_us;
+	p[3].value.a = stats.p99_us;
+	p[3].value.b = stats.idle_evictions;
+
+	return TEE_SUCCESS;
+}
+
 /*
  * Trusted Application Entry Points
  */
@@ -152,6 +383,22 @@ static TEE_Result invoke_command(void *psess __unused,
 		return get_alloc_stats(ptypes, params);
 	case STATS_CMD_MEMLEAK_STATS:
 		return get_memleak_stats(ptypes, params);
+	case STATS_CMD_MUTEX_STATS:
+		return get_mutex_stats(ptypes, params);
+	case STATS_CMD_SPINLOCK_STATS:
+		return get_spinlock_stats(ptypes, params);
+	case STATS_CMD_RPC_SHM_STATS:
+		return get_rpc_shm_stats(ptypes, params);
+	case STATS_CMD_THREAD_STATS:
+		return get_thread_stats(ptypes, params);
+	case STATS_CMD_CALL_STATS:
+		return get_call_stats(ptypes, params);
+	case STATS_CMD_LOCK_PROFILE:
+		return get_lock_profile(ptypes, params);
+	case STATS_CMD_TA_CACHE_STATS:
+		return get_ta_cache_stats(ptypes, params);
+	case STATS_CMD_TA_OPEN_STATS:
+		return get_ta_open_stats(ptypes, params);
 	default:
 		break;
 	}
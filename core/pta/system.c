@@ -10,6 +10,7 @@
 #include <kernel/handle.h>
 #include <kernel/huk_subkey.h>
 #include <kernel/ldelf_loader.h>
+#include <kernel/ldelf_syscalls.h>
 #include <kernel/misc.h>
 #include <kernel/msg_param.h>
 #include <kernel/pseudo_ta.h>
@@ -145,7 +146,7 @@ static TEE_Result system_map_zi(struct user_mode_ctx *uctx,
 	pad_begin = params[2].value.a;
 	pad_end = params[2].value.b;
 
-	f = fobj_ta_mem_alloc(ROUNDUP_DIV(num_bytes, SMALL_PAGE_SIZE));
+	f = ldelf_ta_mem_alloc(ROUNDUP_DIV(num_bytes, SMALL_PAGE_SIZE));
 	if (!f)
 		return TEE_ERROR_OUT_OF_MEMORY;
 	mobj = mobj_with_fobj_alloc(f, NULL);
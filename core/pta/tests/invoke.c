@@ -428,6 +428,8 @@ static TEE_Result invoke_command(void *pSessionContext __unused,
 #endif
 	case PTA_INVOKE_TESTS_CMD_MUTEX:
 		return core_mutex_tests(nParamTypes, pParams);
+	case PTA_INVOKE_TESTS_CMD_RWLOCK:
+		return core_rwlock_tests(nParamTypes, pParams);
 	case PTA_INVOKE_TESTS_CMD_LOCKDEP:
 		return core_lockdep_tests(nParamTypes, pParams);
 	case PTA_INVOKE_TEST_CMD_AES_PERF:
@@ -19,6 +19,9 @@ TEE_Result core_fs_htree_tests(uint32_t nParamTypes,
 TEE_Result core_mutex_tests(uint32_t nParamTypes,
 			    TEE_Param pParams[TEE_NUM_PARAMS]);
 
+TEE_Result core_rwlock_tests(uint32_t nParamTypes,
+			     TEE_Param pParams[TEE_NUM_PARAMS]);
+
 #ifdef CFG_LOCKDEP
 TEE_Result core_lockdep_tests(uint32_t nParamTypes,
 			      TEE_Param pParams[TEE_NUM_PARAMS]);
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, The OP-TEE Project Contributors
+ */
+
+#include <atomic.h>
+#include <kernel/rwlock.h>
+#include <pta_invoke_tests.h>
+#include <trace.h>
+
+#include "misc.h"
+
+static uint32_t before_lock_readers;
+static uint32_t before_lock_writers;
+static uint32_t during_lock_readers;
+static uint32_t during_lock_writers;
+
+static uint64_t val0;
+static uint64_t val1;
+
+static struct rwlock test_rwlock = RWLOCK_WRITER_PREF_INITIALIZER;
+
+static TEE_Result rwlock_test_writer(TEE_Param params[TEE_NUM_PARAMS])
+{
+	TEE_Result res = TEE_SUCCESS;
+	size_t n = 0;
+
+	params[1].value.a = atomic_inc32(&before_lock_writers);
+
+	rwlock_write_lock(&test_rwlock);
+
+	atomic_dec32(&before_lock_writers);
+
+	params[1].value.b = atomic_inc32(&during_lock_writers);
+
+	for (n = 0; n < params[0].value.b; n++) {
+		if (atomic_load_u32(&during_lock_readers))
+			res = TEE_ERROR_BAD_STATE;
+		val0++;
+		val1++;
+		val1++;
+	}
+
+	atomic_dec32(&during_lock_writers);
+	rwlock_write_unlock(&test_rwlock);
+
+	return res;
+}
+
+static TEE_Result rwlock_test_reader(TEE_Param params[TEE_NUM_PARAMS])
+{
+	TEE_Result res = TEE_SUCCESS;
+	size_t n = 0;
+
+	params[1].value.a = atomic_inc32(&before_lock_readers);
+
+	rwlock_read_lock(&test_rwlock);
+
+	atomic_dec32(&before_lock_readers);
+
+	params[1].value.b = atomic_inc32(&during_lock_readers);
+
+	/* A writer must not get in while we're reading */
+	if (rwlock_write_trylock(&test_rwlock)) {
+		rwlock_write_unlock(&test_rwlock);
+		res = TEE_ERROR_BAD_STATE;
+	}
+
+	for (n = 0; n < params[0].value.b; n++) {
+		if (atomic_load_u32(&during_lock_writers) ||
+		    val0 * 2 != val1)
+			res = TEE_ERROR_BAD_STATE;
+	}
+
+	atomic_dec32(&during_lock_readers);
+	rwlock_read_unlock(&test_rwlock);
+
+	return res;
+}
+
+TEE_Result core_rwlock_tests(uint32_t param_types,
+			     TEE_Param params[TEE_NUM_PARAMS])
+{
+	uint32_t exp_pt = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+					  TEE_PARAM_TYPE_VALUE_OUTPUT,
+					  TEE_PARAM_TYPE_NONE,
+					  TEE_PARAM_TYPE_NONE);
+
+	if (exp_pt != param_types) {
+		DMSG("bad parameter types");
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	switch (params[0].value.a) {
+	case PTA_RWLOCK_TEST_WRITER:
+		return rwlock_test_writer(params);
+	case PTA_RWLOCK_TEST_READER:
+		return rwlock_test_reader(params);
+	default:
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+}
@@ -4,4 +4,5 @@ srcs-$(CFG_LOCKDEP) += lockdep.c
 srcs-y += misc.c
 cflags-misc.c-y += -fno-builtin
 srcs-y += mutex.c
+srcs-y += rwlock.c
 srcs-y += aes_perf.c
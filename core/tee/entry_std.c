@@ -11,6 +11,7 @@
 #include <io.h>
 #include <kernel/linker.h>
 #include <kernel/msg_param.h>
+#include <kernel/mutex.h>
 #include <kernel/notif.h>
 #include <kernel/panic.h>
 #include <kernel/tee_misc.h>
@@ -19,6 +20,7 @@
 #include <mm/mobj.h>
 #include <optee_msg.h>
 #include <sm/optee_smc.h>
+#include <stdlib.h>
 #include <string.h>
 #include <tee/entry_std.h>
 #include <tee/tee_cryp_utl.h>
@@ -404,6 +406,14 @@ out:
 	arg->ret_origin = err_orig;
 }
 
+#ifdef CFG_CORE_ASYNC_NOTIF
+static void async_invoke_cancel_session(uint32_t session);
+#else
+static void async_invoke_cancel_session(uint32_t session __unused)
+{
+}
+#endif
+
 static void entry_close_session(struct optee_msg_arg *arg, uint32_t num_params)
 {
 	TEE_Result res;
@@ -417,6 +427,9 @@ static void entry_close_session(struct optee_msg_arg *arg, uint32_t num_params)
 	plat_prng_add_jitter_entropy(CRYPTO_RNG_SRC_JITTER_SESSION,
 				     &session_pnum);
 
+	/* Queued requests can't be executed once the session is gone */
+	async_invoke_cancel_session(arg->session);
+
 	s = tee_ta_find_session(arg->session, &tee_open_sessions);
 	res = tee_ta_close_session(s, &tee_open_sessions, NSAPP_IDENTITY);
 out:
@@ -466,6 +479,408 @@ out:
 	arg->ret_origin = err_orig;
 }
 
+/*
+ * Returns the request at offset @offs of the batch buffer @buf of @size
+ * bytes, or NULL if the request doesn't fit in the buffer or isn't an
+ * OPTEE_MSG_CMD_INVOKE_COMMAND request.
+ */
+static struct optee_msg_arg *get_batch_entry(uint8_t *buf, size_t size,
+					     size_t offs,
+					     uint32_t *num_params)
+{
+	struct optee_msg_arg *entry = NULL;
+	size_t end = 0;
+
+	if (ADD_OVERFLOW(offs, sizeof(*entry), &end) || end > size)
+		return NULL;
+
+	entry = (struct optee_msg_arg *)(buf + offs);
+	if (READ_ONCE(entry->cmd) != OPTEE_MSG_CMD_INVOKE_COMMAND)
+		return NULL;
+
+	*num_params = READ_ONCE(entry->num_params);
+	if (*num_params > TEE_NUM_PARAMS)
+		return NULL;
+
+	if (ADD_OVERFLOW(offs, OPTEE_MSG_GET_ARG_SIZE(*num_params), &end) ||
+	    end > size)
+		return NULL;
+
+	return entry;
+}
+
+static void entry_invoke_batch(struct optee_msg_arg *arg, uint32_t num_params)
+{
+	TEE_Result res = TEE_ERROR_BAD_PARAMETERS;
+	struct tee_ta_param param = { 0 };
+	uint64_t saved_attr[TEE_NUM_PARAMS] = { 0 };
+	struct optee_msg_arg *entry = NULL;
+	uint32_t entry_num_params = 0;
+	struct param_mem *mem = NULL;
+	size_t num_entries = 0;
+	uint8_t *buf = NULL;
+	size_t offs = 0;
+	size_t n = 0;
+
+	if (num_params != 2 ||
+	    READ_ONCE(arg->params[0].attr) != OPTEE_MSG_ATTR_TYPE_VALUE_INOUT)
+		goto out;
+	num_entries = READ_ONCE(arg->params[0].u.value.a);
+
+	res = copy_in_params(arg->params + 1, 1, &param, saved_attr);
+	if (res)
+		goto cleanup_shm_refs;
+
+	mem = &param.u[0].mem;
+	if (TEE_PARAM_TYPE_GET(param.types, 0) != TEE_PARAM_TYPE_MEMREF_INOUT ||
+	    !mem->mobj || !mobj_is_nonsec(mem->mobj)) {
+		res = TEE_ERROR_BAD_PARAMETERS;
+		goto cleanup_shm_refs;
+	}
+
+	res = mobj_inc_map(mem->mobj);
+	if (res)
+		goto cleanup_shm_refs;
+
+	buf = mobj_get_va(mem->mobj, mem->offs, mem->size);
+	if (!buf || !IS_ALIGNED_WITH_TYPE(buf, uint64_t)) {
+		res = TEE_ERROR_BAD_PARAMETERS;
+		goto dec_map;
+	}
+
+	/*
+	 * The requests are executed back to back on this thread, each
+	 * one gets its own return code just as a separate
+	 * OPTEE_MSG_CMD_INVOKE_COMMAND would.
+	 */
+	for (n = 0; n < num_entries; n++) {
+		entry = get_batch_entry(buf, mem->size, offs,
+					&entry_num_params);
+		if (!entry)
+			break;
+
+		entry_invoke_command(entry, entry_num_params);
+		offs += OPTEE_MSG_GET_ARG_SIZE(entry_num_params);
+	}
+
+	arg->params[0].u.value.b = n;
+	if (n != num_entries)
+		res = TEE_ERROR_BAD_PARAMETERS;
+
+dec_map:
+	mobj_dec_map(mem->mobj);
+cleanup_shm_refs:
+	cleanup_shm_refs(saved_attr, &param, 1);
+out:
+	arg->ret = res;
+	arg->ret_origin = TEE_ORIGIN_TEE;
+}
+
+#ifdef CFG_CORE_ASYNC_NOTIF
+/* Max number of queued asynchronous requests */
+#define ASYNC_INVOKE_MAX_QUEUED		64
+
+/*
+ * struct async_invoke - queued OPTEE_MSG_CMD_INVOKE_ASYNC request
+ * @id:		id returned to normal world
+ * @session:	session the request was queued for
+ * @param:	memory reference to the buffer holding @entry
+ * @saved_attr:	attribute of the memory reference as supplied
+ * @entry:	the invoke request in the mapped buffer, NULL once the
+ *		buffer is released
+ * @num_params:	number of parameters of @entry
+ * @link:	link in async_invoke_queue or async_invoke_done
+ */
+struct async_invoke {
+	uint32_t id;
+	uint32_t session;
+	struct tee_ta_param param;
+	uint64_t saved_attr[TEE_NUM_PARAMS];
+	struct optee_msg_arg *entry;
+	uint32_t num_params;
+	TAILQ_ENTRY(async_invoke) link;
+};
+
+TAILQ_HEAD(async_invoke_head, async_invoke);
+
+/*
+ * Requests waiting for a runner are in async_invoke_queue, requests
+ * completed without being executed in async_invoke_done until their id
+ * is reported by OPTEE_MSG_CMD_RUN_ASYNC. async_invoke_queued counts
+ * both.
+ */
+static struct async_invoke_head async_invoke_queue =
+	TAILQ_HEAD_INITIALIZER(async_invoke_queue);
+static struct async_invoke_head async_invoke_done =
+	TAILQ_HEAD_INITIALIZER(async_invoke_done);
+static struct mutex async_invoke_mutex = MUTEX_INITIALIZER;
+static size_t async_invoke_queued;
+static uint32_t async_invoke_next_id;
+static uint32_t async_invoke_value;
+static bool async_invoke_value_valid;
+
+/* Releases the request buffer and the shared memory reference */
+static void async_invoke_release(struct async_invoke *ai)
+{
+	if (!ai->entry)
+		return;
+
+	mobj_dec_map(ai->param.u[0].mem.mobj);
+	cleanup_shm_refs(ai->saved_attr, &ai->param, 1);
+	ai->entry = NULL;
+}
+
+static void async_invoke_free(struct async_invoke *ai)
+{
+	async_invoke_release(ai);
+	free(ai);
+}
+
+/*
+ * Completes the queued request @ai with @res without executing it, the
+ * id is reported by the next OPTEE_MSG_CMD_RUN_ASYNC. Called with
+ * async_invoke_mutex held.
+ */
+static void async_invoke_cancel(struct async_invoke *ai, TEE_Result res)
+{
+	TAILQ_REMOVE(&async_invoke_queue, ai, link);
+	ai->entry->ret = res;
+	ai->entry->ret_origin = TEE_ORIGIN_TEE;
+	async_invoke_release(ai);
+	TAILQ_INSERT_TAIL(&async_invoke_done, ai, link);
+}
+
+static void async_invoke_cancel_session(uint32_t session)
+{
+	struct async_invoke *next = NULL;
+	struct async_invoke *ai = NULL;
+	bool cancelled = false;
+
+	mutex_lock(&async_invoke_mutex);
+	TAILQ_FOREACH_SAFE(ai, &async_invoke_queue, link, next) {
+		if (ai->session == session) {
+			async_invoke_cancel(ai, TEE_ERROR_CANCEL);
+			cancelled = true;
+		}
+	}
+	mutex_unlock(&async_invoke_mutex);
+
+	/* Ask for a runner to report the completed requests */
+	if (cancelled)
+		notif_send_async(async_invoke_value);
+}
+
+/*
+ * Normal world doesn't serve notifications any longer, complete all
+ * queued requests and forget about them since no runner will come.
+ */
+static void async_invoke_stop(void)
+{
+	struct async_invoke *ai = NULL;
+
+	mutex_lock(&async_invoke_mutex);
+	while (true) {
+		ai = TAILQ_FIRST(&async_invoke_queue);
+		if (ai)
+			async_invoke_cancel(ai, TEE_ERROR_CANCEL);
+		ai = TAILQ_FIRST(&async_invoke_done);
+		if (!ai)
+			break;
+		TAILQ_REMOVE(&async_invoke_done, ai, link);
+		async_invoke_queued--;
+		free(ai);
+	}
+	mutex_unlock(&async_invoke_mutex);
+}
+
+#ifndef CFG_CORE_FFA
+#ifdef CFG_CORE_DYN_SHM
+/*
+ * The buffers of queued requests hold a reference to the shared memory
+ * object, complete the requests using the shared memory with @cookie
+ * with TEE_ERROR_CANCEL or unregistering it would wait for ever.
+ */
+static void async_invoke_drop_shm(uint64_t cookie)
+{
+	struct async_invoke *next = NULL;
+	struct async_invoke *ai = NULL;
+	bool cancelled = false;
+
+	mutex_lock(&async_invoke_mutex);
+	TAILQ_FOREACH_SAFE(ai, &async_invoke_queue, link, next) {
+		if (mobj_get_cookie(ai->param.u[0].mem.mobj) != cookie)
+			continue;
+		DMSG("Cancelling request %"PRIu32" of unregistered shm",
+		     ai->id);
+		async_invoke_cancel(ai, TEE_ERROR_CANCEL);
+		cancelled = true;
+	}
+	mutex_unlock(&async_invoke_mutex);
+
+	/* Ask for a runner to report the completed requests */
+	if (cancelled)
+		notif_send_async(async_invoke_value);
+}
+#endif /*CFG_CORE_DYN_SHM*/
+#endif /*!CFG_CORE_FFA*/
+
+static TEE_Result async_invoke_queue_req(struct async_invoke *ai,
+					 uint32_t *notif_value)
+{
+	TEE_Result res = TEE_SUCCESS;
+
+	mutex_lock(&async_invoke_mutex);
+
+	if (!async_invoke_value_valid) {
+		res = notif_alloc_async_value(&async_invoke_value);
+		if (res)
+			goto out;
+		async_invoke_value_valid = true;
+	}
+
+	if (async_invoke_queued >= ASYNC_INVOKE_MAX_QUEUED) {
+		res = TEE_ERROR_BUSY;
+		goto out;
+	}
+
+	/* 0 is never used as request id */
+	async_invoke_next_id++;
+	if (!async_invoke_next_id)
+		async_invoke_next_id++;
+	ai->id = async_invoke_next_id;
+	ai->session = READ_ONCE(ai->entry->session);
+	*notif_value = async_invoke_value;
+
+	TAILQ_INSERT_TAIL(&async_invoke_queue, ai, link);
+	async_invoke_queued++;
+out:
+	mutex_unlock(&async_invoke_mutex);
+
+	return res;
+}
+
+static void entry_invoke_async(struct optee_msg_arg *arg, uint32_t num_params)
+{
+	TEE_Result res = TEE_ERROR_BAD_PARAMETERS;
+	struct async_invoke *ai = NULL;
+	struct param_mem *mem = NULL;
+	uint32_t notif_value = 0;
+	uint8_t *buf = NULL;
+
+	if (num_params != 2 ||
+	    READ_ONCE(arg->params[0].attr) != OPTEE_MSG_ATTR_TYPE_VALUE_OUTPUT)
+		goto out;
+
+	ai = calloc(1, sizeof(*ai));
+	if (!ai) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto out;
+	}
+
+	res = copy_in_params(arg->params + 1, 1, &ai->param, ai->saved_attr);
+	if (res)
+		goto cleanup_shm_refs;
+
+	mem = &ai->param.u[0].mem;
+	if (TEE_PARAM_TYPE_GET(ai->param.types, 0) !=
+	    TEE_PARAM_TYPE_MEMREF_INOUT ||
+	    !mem->mobj || !mobj_is_nonsec(mem->mobj)) {
+		res = TEE_ERROR_BAD_PARAMETERS;
+		goto cleanup_shm_refs;
+	}
+
+	res = mobj_inc_map(mem->mobj);
+	if (res)
+		goto cleanup_shm_refs;
+
+	buf = mobj_get_va(mem->mobj, mem->offs, mem->size);
+	if (buf && IS_ALIGNED_WITH_TYPE(buf, uint64_t))
+		ai->entry = get_batch_entry(buf, mem->size, 0,
+					    &ai->num_params);
+	if (!ai->entry) {
+		res = TEE_ERROR_BAD_PARAMETERS;
+		goto dec_map;
+	}
+
+	res = async_invoke_queue_req(ai, &notif_value);
+	if (res)
+		goto dec_map;
+
+	arg->params[0].u.value.a = ai->id;
+	arg->params[0].u.value.b = notif_value;
+	arg->ret = TEE_SUCCESS;
+	arg->ret_origin = TEE_ORIGIN_TEE;
+
+	/* Ask normal world for a thread to run the request */
+	notif_send_async(notif_value);
+	return;
+
+dec_map:
+	mobj_dec_map(mem->mobj);
+cleanup_shm_refs:
+	cleanup_shm_refs(ai->saved_attr, &ai->param, 1);
+	free(ai);
+out:
+	arg->ret = res;
+	arg->ret_origin = TEE_ORIGIN_TEE;
+}
+
+static void entry_run_async(struct optee_msg_arg *arg, uint32_t num_params)
+{
+	struct async_invoke *ai = NULL;
+	bool more = false;
+
+	if (num_params != 1 ||
+	    READ_ONCE(arg->params[0].attr) != OPTEE_MSG_ATTR_TYPE_VALUE_OUTPUT) {
+		arg->ret = TEE_ERROR_BAD_PARAMETERS;
+		goto out;
+	}
+
+	/* Report requests completed without a runner first */
+	mutex_lock(&async_invoke_mutex);
+	ai = TAILQ_FIRST(&async_invoke_done);
+	if (ai) {
+		TAILQ_REMOVE(&async_invoke_done, ai, link);
+	} else {
+		ai = TAILQ_FIRST(&async_invoke_queue);
+		if (ai)
+			TAILQ_REMOVE(&async_invoke_queue, ai, link);
+	}
+	if (ai)
+		async_invoke_queued--;
+	more = !TAILQ_EMPTY(&async_invoke_queue) ||
+	       !TAILQ_EMPTY(&async_invoke_done);
+	mutex_unlock(&async_invoke_mutex);
+
+	if (!ai) {
+		arg->ret = TEE_ERROR_NO_DATA;
+		goto out;
+	}
+
+	if (ai->entry)
+		entry_invoke_command(ai->entry, ai->num_params);
+
+	arg->params[0].u.value.a = ai->id;
+	arg->params[0].u.value.b = more;
+	arg->ret = TEE_SUCCESS;
+	async_invoke_free(ai);
+out:
+	arg->ret_origin = TEE_ORIGIN_TEE;
+}
+#else /*CFG_CORE_ASYNC_NOTIF*/
+static void async_invoke_stop(void)
+{
+}
+
+#ifndef CFG_CORE_FFA
+#ifdef CFG_CORE_DYN_SHM
+static void async_invoke_drop_shm(uint64_t cookie __unused)
+{
+}
+#endif /*CFG_CORE_DYN_SHM*/
+#endif /*!CFG_CORE_FFA*/
+#endif /*CFG_CORE_ASYNC_NOTIF*/
+
 static void entry_cancel(struct optee_msg_arg *arg, uint32_t num_params)
 {
 	TEE_Result res;
@@ -520,7 +935,10 @@ static void unregister_shm(struct optee_msg_arg *arg, uint32_t num_params)
 {
 	if (num_params == 1) {
 		uint64_t cookie = arg->params[0].u.rmem.shm_ref;
-		TEE_Result res = mobj_reg_shm_release_by_cookie(cookie);
+		TEE_Result res = TEE_SUCCESS;
+
+		async_invoke_drop_shm(cookie);
+		res = mobj_reg_shm_release_by_cookie(cookie);
 
 		if (res)
 			EMSG("Can't find mapping with given cookie");
@@ -564,6 +982,12 @@ uint32_t __tee_entry_std(struct optee_msg_arg *arg, uint32_t num_params)
 	case OPTEE_MSG_CMD_INVOKE_COMMAND:
 		entry_invoke_command(arg, num_params);
 		break;
+	case OPTEE_MSG_CMD_INVOKE_BATCH:
+		if (IS_ENABLED(CFG_CORE_INVOKE_BATCH))
+			entry_invoke_batch(arg, num_params);
+		else
+			goto err;
+		break;
 	case OPTEE_MSG_CMD_CANCEL:
 		entry_cancel(arg, num_params);
 		break;
@@ -585,11 +1009,21 @@ uint32_t __tee_entry_std(struct optee_msg_arg *arg, uint32_t num_params)
 			goto err;
 		break;
 	case OPTEE_MSG_CMD_STOP_ASYNC_NOTIF:
-		if (IS_ENABLED(CFG_CORE_ASYNC_NOTIF))
+		if (IS_ENABLED(CFG_CORE_ASYNC_NOTIF)) {
+			async_invoke_stop();
 			notif_deliver_event(NOTIF_EVENT_STOPPED);
-		else
+		} else {
 			goto err;
+		}
+		break;
+#ifdef CFG_CORE_ASYNC_NOTIF
+	case OPTEE_MSG_CMD_INVOKE_ASYNC:
+		entry_invoke_async(arg, num_params);
 		break;
+	case OPTEE_MSG_CMD_RUN_ASYNC:
+		entry_run_async(arg, num_params);
+		break;
+#endif
 
 	default:
 err:
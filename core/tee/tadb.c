@@ -6,7 +6,7 @@
 #include <assert.h>
 #include <bitstring.h>
 #include <crypto/crypto.h>
-#include <kernel/mutex.h>
+#include <kernel/rwlock.h>
 #include <kernel/thread.h>
 #include <mm/mobj.h>
 #include <optee_rpc_cmd.h>
@@ -76,7 +76,18 @@ struct tee_tadb_ta_read {
 static const char tadb_obj_id[] = "ta.db";
 static struct tee_tadb_dir *tadb_db;
 static unsigned int tadb_db_refc;
-static struct mutex tadb_mutex = MUTEX_INITIALIZER;
+static struct rwlock tadb_lock = RWLOCK_INITIALIZER;
+
+/*
+ * In-memory copy of the UUIDs of the TA database entries, indexed as the
+ * database, so a TA can be found without reading each entry. A null UUID
+ * is a free entry. The index outlives tadb_db since only this file updates
+ * the database. It's read with tadb_lock held for reading and updated
+ * with tadb_lock held exclusively.
+ */
+static TEE_UUID *tadb_index;
+static size_t tadb_index_len;
+static bool tadb_index_valid;
 
 static void file_num_to_str(char *buf, size_t blen, uint32_t file_number)
 {
@@ -210,6 +221,40 @@ static TEE_Result write_ent(struct tee_tadb_dir *db, size_t idx,
 	return db->ops->write(db->fh, idx * l, entry, l);
 }
 
+static void index_invalidate(void)
+{
+	free(tadb_index);
+	tadb_index = NULL;
+	tadb_index_len = 0;
+	tadb_index_valid = false;
+}
+
+/* Records that entry @idx now holds @uuid, called with tadb_lock held */
+static void index_update(size_t idx, const TEE_UUID *uuid)
+{
+	TEE_UUID *p = NULL;
+
+	if (!tadb_index_valid)
+		return;
+
+	if (idx > tadb_index_len) {
+		index_invalidate();
+		return;
+	}
+
+	if (idx == tadb_index_len) {
+		p = realloc(tadb_index, (idx + 1) * sizeof(*p));
+		if (!p) {
+			index_invalidate();
+			return;
+		}
+		tadb_index = p;
+		tadb_index_len++;
+	}
+
+	tadb_index[idx] = *uuid;
+}
+
 static TEE_Result tadb_open(struct tee_tadb_dir **db_ret)
 {
 	TEE_Result res;
@@ -241,7 +286,7 @@ static TEE_Result tee_tadb_open(struct tee_tadb_dir **db)
 {
 	TEE_Result res = TEE_SUCCESS;
 
-	mutex_lock(&tadb_mutex);
+	rwlock_write_lock(&tadb_lock);
 	if (!tadb_db_refc) {
 		assert(!tadb_db);
 		res = tadb_open(&tadb_db);
@@ -251,14 +296,14 @@ static TEE_Result tee_tadb_open(struct tee_tadb_dir **db)
 	tadb_db_refc++;
 	*db = tadb_db;
 err:
-	mutex_unlock(&tadb_mutex);
+	rwlock_write_unlock(&tadb_lock);
 	return res;
 }
 
 static void tadb_put(struct tee_tadb_dir *db)
 {
 	assert(db == tadb_db);
-	mutex_lock(&tadb_mutex);
+	rwlock_write_lock(&tadb_lock);
 	assert(tadb_db_refc);
 	tadb_db_refc--;
 	if (!tadb_db_refc) {
@@ -267,7 +312,7 @@ static void tadb_put(struct tee_tadb_dir *db)
 		free(db);
 		tadb_db = NULL;
 	}
-	mutex_unlock(&tadb_mutex);
+	rwlock_write_unlock(&tadb_lock);
 }
 
 static void tee_tadb_close(struct tee_tadb_dir *db)
@@ -351,8 +396,11 @@ static TEE_Result populate_files(struct tee_tadb_dir *db)
 			     entry.file_number);
 			memset(&entry, 0, sizeof(entry));
 			res = write_ent(db, idx, &entry);
-			if (res)
+			if (res) {
+				index_invalidate();
 				goto err;
+			}
+			index_update(idx, &entry.prop.uuid);
 			continue;
 		}
 
@@ -387,7 +435,7 @@ TEE_Result tee_tadb_ta_create(const struct tee_tadb_property *property,
 	if (res)
 		goto err_free;
 
-	mutex_lock(&tadb_mutex);
+	rwlock_write_lock(&tadb_lock);
 
 	/*
 	 * Since we're going to search for next free file number below we
@@ -395,7 +443,7 @@ TEE_Result tee_tadb_ta_create(const struct tee_tadb_property *property,
 	 */
 	res = populate_files(ta->db);
 	if (res)
-		goto err_mutex;
+		goto err_unlock;
 
 	if (ta->db->files) {
 		bit_ffc(ta->db->files, ta->db->nbits, &i);
@@ -405,9 +453,9 @@ TEE_Result tee_tadb_ta_create(const struct tee_tadb_property *property,
 
 	res = set_file(ta->db, i);
 	if (res)
-		goto err_mutex;
+		goto err_unlock;
 
-	mutex_unlock(&tadb_mutex);
+	rwlock_write_unlock(&tadb_lock);
 
 	ta->entry.file_number = i;
 	ta->entry.prop = *property;
@@ -433,8 +481,8 @@ TEE_Result tee_tadb_ta_create(const struct tee_tadb_property *property,
 
 	return TEE_SUCCESS;
 
-err_mutex:
-	mutex_unlock(&tadb_mutex);
+err_unlock:
+	rwlock_write_unlock(&tadb_lock);
 err_put:
 	tadb_put(ta->db);
 err_free:
@@ -484,27 +532,65 @@ void tee_tadb_ta_close_and_delete(struct tee_tadb_ta_write *ta)
 	tee_fs_rpc_close(OPTEE_RPC_CMD_FS, ta->fd);
 	ta_operation_remove(ta->entry.file_number);
 
-	mutex_lock(&tadb_mutex);
+	rwlock_write_lock(&tadb_lock);
 	clear_file(ta->db, ta->entry.file_number);
-	mutex_unlock(&tadb_mutex);
+	rwlock_write_unlock(&tadb_lock);
 
 	tadb_put(ta->db);
 	free(ta);
 }
 
-static TEE_Result find_ent(struct tee_tadb_dir *db, const TEE_UUID *uuid,
-			   size_t *idx_ret, struct tadb_entry *entry_ret)
+/*
+ * Looks up @uuid in the index, called with tadb_lock held at least for
+ * reading and a valid index. Returns TEE_ERROR_BAD_STATE if the entry
+ * read from the database doesn't match the index.
+ */
+static TEE_Result index_find_ent(struct tee_tadb_dir *db,
+				 const TEE_UUID *uuid, size_t *idx_ret,
+				 struct tadb_entry *entry_ret)
 {
-	TEE_Result res;
-	size_t idx;
+	TEE_Result res = TEE_SUCCESS;
+	size_t idx = 0;
+
+	assert(tadb_index_valid);
+
+	while (idx < tadb_index_len &&
+	       memcmp(tadb_index + idx, uuid, sizeof(*uuid)))
+		idx++;
+
+	*idx_ret = idx;
+	if (idx == tadb_index_len)
+		return TEE_ERROR_ITEM_NOT_FOUND;
+	if (!entry_ret)
+		return TEE_SUCCESS;
+
+	res = read_ent(db, idx, entry_ret);
+	if (res == TEE_ERROR_ITEM_NOT_FOUND)
+		return TEE_ERROR_BAD_STATE;
+	if (res)
+		return res;
+	if (memcmp(&entry_ret->prop.uuid, uuid, sizeof(*uuid)))
+		return TEE_ERROR_BAD_STATE;
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Reads all entries of the database to find @uuid and rebuilds the index
+ * on the way, called with tadb_lock held exclusively.
+ */
+static TEE_Result scan_ents(struct tee_tadb_dir *db, const TEE_UUID *uuid,
+			    size_t *idx_ret, struct tadb_entry *entry_ret)
+{
+	TEE_Result res = TEE_SUCCESS;
+	TEE_UUID *index = NULL;
+	size_t index_size = 0;
+	bool found = false;
+	size_t idx = 0;
+	void *p = NULL;
+
+	index_invalidate();
 
-	/*
-	 * Search for the provided uuid, if it's found return the index it
-	 * has together with TEE_SUCCESS.
-	 *
-	 * If the uuid can't be found return the number indexes together
-	 * with TEE_ERROR_ITEM_NOT_FOUND.
-	 */
 	for (idx = 0;; idx++) {
 		struct tadb_entry entry;
 
@@ -512,18 +598,69 @@ static TEE_Result find_ent(struct tee_tadb_dir *db, const TEE_UUID *uuid,
 		if (res) {
 			if (res == TEE_ERROR_ITEM_NOT_FOUND)
 				break;
+			free(index);
 			return res;
 		}
 
-		if (!memcmp(&entry.prop.uuid, uuid, sizeof(*uuid))) {
+		if (!found && !memcmp(&entry.prop.uuid, uuid, sizeof(*uuid))) {
 			if (entry_ret)
 				*entry_ret = entry;
-			break;
+			*idx_ret = idx;
+			found = true;
+		}
+
+		if (idx == index_size) {
+			index_size = MAX(2 * index_size, 16U);
+			p = realloc(index, index_size * sizeof(*index));
+			if (!p) {
+				free(index);
+				index = NULL;
+				/* Continue without building the index */
+				if (found)
+					return TEE_SUCCESS;
+				index_size = SIZE_MAX;
+				continue;
+			}
+			index = p;
 		}
+		if (index)
+			index[idx] = entry.prop.uuid;
 	}
 
+	if (index) {
+		tadb_index = index;
+		tadb_index_len = idx;
+		tadb_index_valid = true;
+	}
+
+	if (found)
+		return TEE_SUCCESS;
 	*idx_ret = idx;
-	return res;
+	return TEE_ERROR_ITEM_NOT_FOUND;
+}
+
+static TEE_Result find_ent(struct tee_tadb_dir *db, const TEE_UUID *uuid,
+			   size_t *idx_ret, struct tadb_entry *entry_ret)
+{
+	TEE_Result res = TEE_SUCCESS;
+
+	/*
+	 * Search for the provided uuid, if it's found return the index it
+	 * has together with TEE_SUCCESS.
+	 *
+	 * If the uuid can't be found return the number indexes together
+	 * with TEE_ERROR_ITEM_NOT_FOUND.
+	 *
+	 * Called with tadb_lock held exclusively.
+	 */
+	if (tadb_index_valid) {
+		res = index_find_ent(db, uuid, idx_ret, entry_ret);
+		if (res != TEE_ERROR_BAD_STATE)
+			return res;
+		EMSG("TA database index out of sync, rebuilding");
+	}
+
+	return scan_ents(db, uuid, idx_ret, entry_ret);
 }
 
 static TEE_Result find_free_ent_idx(struct tee_tadb_dir *db, size_t *idx)
@@ -556,7 +693,7 @@ TEE_Result tee_tadb_ta_close_and_commit(struct tee_tadb_ta_write *ta)
 
 	tee_fs_rpc_close(OPTEE_RPC_CMD_FS, ta->fd);
 
-	mutex_lock(&tadb_mutex);
+	rwlock_write_lock(&tadb_lock);
 	/*
 	 * First try to find an existing TA to replace. If there's one
 	 * we'll use the entry, but we should also remove the old encrypted
@@ -570,14 +707,17 @@ TEE_Result tee_tadb_ta_close_and_commit(struct tee_tadb_ta_write *ta)
 	} else {
 		res = find_free_ent_idx(ta->db, &idx);
 		if (res)
-			goto err_mutex;
+			goto err_unlock;
 	}
 	res = write_ent(ta->db, idx, &ta->entry);
-	if (res)
-		goto err_mutex;
+	if (res) {
+		index_invalidate();
+		goto err_unlock;
+	}
+	index_update(idx, &ta->entry.prop.uuid);
 	if (have_old_ent)
 		clear_file(ta->db, old_ent.file_number);
-	mutex_unlock(&tadb_mutex);
+	rwlock_write_unlock(&tadb_lock);
 
 	crypto_authenc_final(ta->ctx);
 	crypto_authenc_free_ctx(ta->ctx);
@@ -587,8 +727,8 @@ TEE_Result tee_tadb_ta_close_and_commit(struct tee_tadb_ta_write *ta)
 		ta_operation_remove(old_ent.file_number);
 	return TEE_SUCCESS;
 
-err_mutex:
-	mutex_unlock(&tadb_mutex);
+err_unlock:
+	rwlock_write_unlock(&tadb_lock);
 err:
 	tee_tadb_ta_close_and_delete(ta);
 	return res;
@@ -609,17 +749,21 @@ TEE_Result tee_tadb_ta_delete(const TEE_UUID *uuid)
 	if (res)
 		return res;
 
-	mutex_lock(&tadb_mutex);
+	rwlock_write_lock(&tadb_lock);
 	res = find_ent(db, uuid, &idx, &entry);
 	if (res) {
-		mutex_unlock(&tadb_mutex);
+		rwlock_write_unlock(&tadb_lock);
 		tee_tadb_close(db);
 		return res;
 	}
 
 	clear_file(db, entry.file_number);
 	res = write_ent(db, idx, &null_entry);
-	mutex_unlock(&tadb_mutex);
+	if (res)
+		index_invalidate();
+	else
+		index_update(idx, &null_entry.prop.uuid);
+	rwlock_write_unlock(&tadb_lock);
 
 	tee_tadb_close(db);
 	if (res)
@@ -647,9 +791,21 @@ TEE_Result tee_tadb_ta_open(const TEE_UUID *uuid,
 	if (res)
 		goto err_free; /* Mustn't call tadb_put() */
 
-	mutex_read_lock(&tadb_mutex);
-	res = find_ent(ta->db, uuid, &idx, &ta->entry);
-	mutex_read_unlock(&tadb_mutex);
+	/*
+	 * Concurrent opens look up the index in parallel, the exclusive
+	 * lock is only needed when the index has to be rebuilt.
+	 */
+	rwlock_read_lock(&tadb_lock);
+	if (tadb_index_valid)
+		res = index_find_ent(ta->db, uuid, &idx, &ta->entry);
+	else
+		res = TEE_ERROR_BAD_STATE;
+	rwlock_read_unlock(&tadb_lock);
+	if (res == TEE_ERROR_BAD_STATE) {
+		rwlock_write_lock(&tadb_lock);
+		res = find_ent(ta->db, uuid, &idx, &ta->entry);
+		rwlock_write_unlock(&tadb_lock);
+	}
 	if (res)
 		goto err;
 
@@ -11,6 +11,7 @@
 
 int trace_level = TRACE_LEVEL;
 const char trace_ext_prefix[]  = "LD";
+bool sys_in_ta_context;
 
 void __panic(const char *file __maybe_unused, const int line __maybe_unused,
 	     const char *func __maybe_unused)
@@ -36,6 +37,17 @@ void sys_return_cleanup(void)
 		;
 }
 
+void sys_return_error(TEE_Result res)
+{
+	if (sys_in_ta_context)
+		_ldelf_panic(res);
+	else
+		_ldelf_return(res);
+	/*NOTREACHED*/
+	while (true)
+		;
+}
+
 TEE_Result sys_map_zi(size_t num_bytes, uint32_t flags, vaddr_t *va,
 		      size_t pad_begin, size_t pad_end)
 {
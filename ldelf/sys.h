@@ -9,6 +9,7 @@
 
 #include <compiler.h>
 #include <ldelf_syscalls.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <tee_api_types.h>
 #include <trace.h>
@@ -25,13 +26,22 @@
 #define SMALL_PAGE_MASK		0x00000fff
 #define SMALL_PAGE_SIZE		0x00001000
 
+/*
+ * Set while ldelf executes on behalf of the TA, that is, when binding a
+ * PLT entry on first call. The TA syscalls used for logging and panic
+ * have the same numbers as LDELF_LOG and LDELF_PANIC, but an error must
+ * panic the TA instead of returning from ldelf.
+ */
+extern bool sys_in_ta_context;
+
 void __noreturn __panic(const char *file, const int line, const char *func);
 void __noreturn sys_return_cleanup(void);
+void __noreturn sys_return_error(TEE_Result res);
 
 #define err(res, ...) \
 	do { \
 		trace_printf_helper(TRACE_ERROR, true, __VA_ARGS__); \
-		_ldelf_return(res); \
+		sys_return_error(res); \
 	} while (0)
 
 TEE_Result sys_map_zi(size_t num_bytes, uint32_t flags, vaddr_t *va,
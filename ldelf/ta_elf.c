@@ -215,10 +215,10 @@ static void save_hashtab_from_segment(struct ta_elf *elf, unsigned int type,
 
 	for (n = 0; n < num_dyns; n++) {
 		read_dyn(elf, addr, n, &tag, &val);
-		if (tag == DT_HASH) {
+		if (tag == DT_HASH)
 			elf->hashtab = (void *)(val + elf->load_addr);
-			break;
-		}
+		else if (tag == DT_GNU_HASH)
+			elf->gnu_hashtab = (void *)(val + elf->load_addr);
 	}
 }
 
@@ -262,6 +262,49 @@ static void check_hashtab(struct ta_elf *elf, void *ptr, size_t num_buckets,
 	check_range(elf, "DT_HASH", ptr, sz);
 }
 
+static void check_gnu_hashtab(struct ta_elf *elf)
+{
+	/*
+	 * The table starts with four words: num_buckets, symoffset,
+	 * bloom_size and bloom_shift. They are followed by bloom_size
+	 * ELF class sized Bloom filter words, num_buckets 32-bit buckets
+	 * and one 32-bit chain word for each dynamic symbol from
+	 * symoffset and onwards.
+	 */
+	uint32_t *hashtab = elf->gnu_hashtab;
+	size_t bloom_entsize = sizeof(uint64_t);
+	size_t num_words = 0;
+	size_t bloom_sz = 0;
+	size_t sz = 4 * sizeof(uint32_t);
+
+	if (elf->is_32bit)
+		bloom_entsize = sizeof(uint32_t);
+
+	if (!IS_ALIGNED((vaddr_t)hashtab, bloom_entsize))
+		err(TEE_ERROR_BAD_FORMAT, "Bad alignment of DT_GNU_HASH %p",
+		    (void *)hashtab);
+
+	check_range(elf, "DT_GNU_HASH", hashtab, sz);
+
+	if (!hashtab[0] || !hashtab[2])
+		err(TEE_ERROR_BAD_FORMAT, "Empty DT_GNU_HASH");
+	/* The hash is shifted right by bloom_shift, a 32-bit value */
+	if (hashtab[3] >= 32)
+		err(TEE_ERROR_BAD_FORMAT, "DT_GNU_HASH bloom_shift too large");
+	if (hashtab[1] > elf->num_dynsyms)
+		err(TEE_ERROR_BAD_FORMAT, "DT_GNU_HASH symoffset out of range");
+
+	num_words = elf->num_dynsyms - hashtab[1];
+	if (ADD_OVERFLOW(num_words, hashtab[0], &num_words) ||
+	    MUL_OVERFLOW(num_words, sizeof(uint32_t), &num_words) ||
+	    MUL_OVERFLOW(hashtab[2], bloom_entsize, &bloom_sz) ||
+	    ADD_OVERFLOW(sz, bloom_sz, &sz) ||
+	    ADD_OVERFLOW(sz, num_words, &sz))
+		err(TEE_ERROR_BAD_FORMAT, "DT_GNU_HASH overflow");
+
+	check_range(elf, "DT_GNU_HASH", hashtab, sz);
+}
+
 static void save_hashtab(struct ta_elf *elf)
 {
 	uint32_t *hashtab = NULL;
@@ -283,6 +326,13 @@ static void save_hashtab(struct ta_elf *elf)
 						  phdr[n].p_memsz);
 	}
 
+	/* DT_HASH is only needed if there's no DT_GNU_HASH */
+	if (elf->gnu_hashtab) {
+		check_gnu_hashtab(elf);
+		elf->hashtab = NULL;
+		return;
+	}
+
 	check_hashtab(elf, elf->hashtab, 0, 0);
 	hashtab = elf->hashtab;
 	check_hashtab(elf, elf->hashtab, hashtab[0], hashtab[1]);
@@ -346,6 +396,90 @@ static void save_soname(struct ta_elf *elf)
 	}
 }
 
+static void save_plt_from_segment(struct ta_elf *elf, unsigned int type,
+				  vaddr_t addr, size_t memsz)
+{
+	size_t dyn_entsize = 0;
+	size_t num_dyns = 0;
+	size_t n = 0;
+	unsigned int tag = 0;
+	size_t val = 0;
+
+	if (type != PT_DYNAMIC)
+		return;
+
+	if (elf->is_32bit)
+		dyn_entsize = sizeof(Elf32_Dyn);
+	else
+		dyn_entsize = sizeof(Elf64_Dyn);
+
+	assert(!(memsz % dyn_entsize));
+	num_dyns = memsz / dyn_entsize;
+
+	for (n = 0; n < num_dyns; n++) {
+		read_dyn(elf, addr, n, &tag, &val);
+		switch (tag) {
+		case DT_PLTGOT:
+			elf->pltgot = val + elf->load_addr;
+			break;
+		case DT_JMPREL:
+			elf->jmprel = val + elf->load_addr;
+			break;
+		case DT_PLTRELSZ:
+			elf->pltrelsz = val;
+			break;
+		case DT_FLAGS:
+			if (val & DF_BIND_NOW)
+				elf->bind_now = true;
+			break;
+		case DT_FLAGS_1:
+			if (val & DF_1_BIND_NOW)
+				elf->bind_now = true;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void save_plt(struct ta_elf *elf)
+{
+	size_t n = 0;
+
+	if (elf->is_32bit) {
+		Elf32_Phdr *phdr = elf->phdr;
+
+		for (n = 0; n < elf->e_phnum; n++)
+			save_plt_from_segment(elf, phdr[n].p_type,
+					      phdr[n].p_vaddr,
+					      phdr[n].p_memsz);
+	} else {
+		Elf64_Phdr *phdr = elf->phdr;
+
+		for (n = 0; n < elf->e_phnum; n++)
+			save_plt_from_segment(elf, phdr[n].p_type,
+					      phdr[n].p_vaddr,
+					      phdr[n].p_memsz);
+	}
+
+	if (!elf->pltgot || !elf->jmprel)
+		return;
+
+	/* The first three words of the GOT are reserved for lazy binding */
+	if (elf->is_32bit) {
+		check_range(elf, "DT_PLTGOT", (void *)elf->pltgot,
+			    3 * sizeof(Elf32_Addr));
+	} else {
+		if (!IS_ALIGNED_WITH_TYPE(elf->pltgot, Elf64_Addr) ||
+		    !IS_ALIGNED_WITH_TYPE(elf->jmprel, Elf64_Rela))
+			err(TEE_ERROR_BAD_FORMAT,
+			    "Bad alignment of DT_PLTGOT or DT_JMPREL");
+		check_range(elf, "DT_PLTGOT", (void *)elf->pltgot,
+			    3 * sizeof(Elf64_Addr));
+	}
+	check_range(elf, "DT_JMPREL", (void *)elf->jmprel, elf->pltrelsz);
+}
+
 static void e32_save_symtab(struct ta_elf *elf, size_t tab_idx)
 {
 	Elf32_Shdr *shdr = elf->shdr;
@@ -425,6 +559,7 @@ static void save_symtab(struct ta_elf *elf)
 
 	save_hashtab(elf);
 	save_soname(elf);
+	save_plt(elf);
 }
 
 static void init_elf(struct ta_elf *elf)
@@ -504,6 +639,52 @@ static void add_segment(struct ta_elf *elf, size_t offset, size_t vaddr,
 	TAILQ_INSERT_TAIL(&elf->segs, seg, link);
 }
 
+/*
+ * Looks for the note added by CFG_TA_PRELINK=y in the notes at @offset
+ * of size @size. Only the first page of the ELF is mapped at this stage,
+ * notes outside of it are of no interest here.
+ */
+static void parse_prelink_note(struct ta_elf *elf, size_t offset, size_t size)
+{
+	const char name[] = TA_PRELINK_NOTE_NAME;
+	struct ta_prelink_note pn = { };
+	uint64_t base = 0;
+	Elf_Note note = { };
+	size_t sz = 0;
+
+	if (offset >= SMALL_PAGE_SIZE || size > SMALL_PAGE_SIZE - offset)
+		return;
+
+	while (size >= sizeof(note)) {
+		memcpy(&note, (void *)(elf->ehdr_addr + offset), sizeof(note));
+		/* Other notes are not checked, only stop at garbage */
+		if (note.n_namesz > size || note.n_descsz > size)
+			return;
+		sz = sizeof(note) + ROUNDUP(note.n_namesz, 4) +
+		     ROUNDUP(note.n_descsz, 4);
+		if (sz > size)
+			return;
+
+		if (note.n_type == TA_PRELINK_NOTE_TYPE &&
+		    note.n_namesz == sizeof(name) &&
+		    note.n_descsz == sizeof(uint32_t) * 2 &&
+		    !memcmp((void *)(elf->ehdr_addr + offset + sizeof(note)),
+			    name, sizeof(name))) {
+			memcpy(&pn, (void *)(elf->ehdr_addr + offset),
+			       sizeof(pn));
+			base = ((uint64_t)pn.base_hi << 32) | pn.base_lo;
+			if (base != (vaddr_t)base || (base & SMALL_PAGE_MASK))
+				err(TEE_ERROR_BAD_FORMAT,
+				    "Bad prelink base %#"PRIx64, base);
+			elf->prelink_base = base;
+			return;
+		}
+
+		offset += sz;
+		size -= sz;
+	}
+}
+
 static void parse_load_segments(struct ta_elf *elf)
 {
 	size_t n = 0;
@@ -517,6 +698,9 @@ static void parse_load_segments(struct ta_elf *elf)
 					    phdr[n].p_vaddr, phdr[n].p_filesz,
 					    phdr[n].p_memsz, phdr[n].p_flags,
 					    phdr[n].p_align);
+			} else if (phdr[n].p_type == PT_NOTE) {
+				parse_prelink_note(elf, phdr[n].p_offset,
+						   phdr[n].p_filesz);
 			} else if (phdr[n].p_type == PT_ARM_EXIDX) {
 				elf->exidx_start = phdr[n].p_vaddr;
 				elf->exidx_size = phdr[n].p_filesz;
@@ -532,6 +716,9 @@ static void parse_load_segments(struct ta_elf *elf)
 					    phdr[n].p_vaddr, phdr[n].p_filesz,
 					    phdr[n].p_memsz, phdr[n].p_flags,
 					    phdr[n].p_align);
+			} else if (phdr[n].p_type == PT_NOTE) {
+				parse_prelink_note(elf, phdr[n].p_offset,
+						   phdr[n].p_filesz);
 			} else if (phdr[n].p_type == PT_TLS) {
 				elf->tls_start = phdr[n].p_vaddr;
 				elf->tls_filesz = phdr[n].p_filesz;
@@ -730,6 +917,25 @@ static size_t get_pad_begin(void)
 #endif /*!CFG_TA_ASLR*/
 }
 
+/*
+ * Returns true if a failed mapping of the first segment of @elf is to be
+ * retried at an address of the kernel's choosing and without @pad_begin.
+ */
+static bool retry_map(struct ta_elf *elf, TEE_Result res, size_t pad_begin,
+		      vaddr_t *va)
+{
+	if (!res || elf->load_addr)
+		return false;
+	if (pad_begin && res == TEE_ERROR_OUT_OF_MEMORY)
+		return true;
+	if (*va) {
+		DMSG("Cannot map at prelink base %#"PRIxVA, elf->prelink_base);
+		*va = 0;
+		return true;
+	}
+	return false;
+}
+
 static void populate_segments(struct ta_elf *elf)
 {
 	TEE_Result res = TEE_SUCCESS;
@@ -811,7 +1017,16 @@ static void populate_segments(struct ta_elf *elf)
 				 * If mapping with pad_begin fails we'll
 				 * retry without pad_begin, effectively
 				 * disabling ASLR for the current ELF file.
+				 *
+				 * Without ASLR a prelinked ELF is mapped
+				 * at its prelink base if possible, the
+				 * relative relocations can be skipped
+				 * then. If the range is taken we retry
+				 * anywhere.
 				 */
+				if (!IS_ENABLED(CFG_TA_ASLR) &&
+				    elf->prelink_base)
+					va = elf->prelink_base + vaddr;
 			} else {
 				va = vaddr + elf->load_addr;
 				pad_begin = 0;
@@ -829,7 +1044,7 @@ static void populate_segments(struct ta_elf *elf)
 			if (flags & LDELF_MAP_FLAG_WRITEABLE) {
 				res = sys_map_zi(memsz, 0, &va, pad_begin,
 						 pad_end);
-				if (pad_begin && res == TEE_ERROR_OUT_OF_MEMORY)
+				if (retry_map(elf, res, pad_begin, &va))
 					res = sys_map_zi(memsz, 0, &va, 0,
 							 pad_end);
 				if (res)
@@ -845,7 +1060,7 @@ static void populate_segments(struct ta_elf *elf)
 				res = sys_map_ta_bin(&va, filesz, flags,
 						     elf->handle, offset,
 						     pad_begin, pad_end);
-				if (pad_begin && res == TEE_ERROR_OUT_OF_MEMORY)
+				if (retry_map(elf, res, pad_begin, &va))
 					res = sys_map_ta_bin(&va, filesz, flags,
 							     elf->handle,
 							     offset, 0,
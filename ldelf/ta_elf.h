@@ -37,6 +37,13 @@ struct ta_elf {
 
 	vaddr_t ehdr_addr;
 
+	/*
+	 * Address the ELF is prelinked at, the relative relocations
+	 * already hold their values for this load address. 0 if not
+	 * prelinked.
+	 */
+	vaddr_t prelink_base;
+
 	/* Initialized from Elf32_Ehdr/Elf64_Ehdr */
 	vaddr_t e_entry;
 	vaddr_t e_phoff;
@@ -59,10 +66,19 @@ struct ta_elf {
 
 	/* DT_HASH hash table for faster resolution of external symbols */
 	void *hashtab;
+	/* DT_GNU_HASH hash table, preferred over DT_HASH when present */
+	void *gnu_hashtab;
 
 	/* DT_SONAME */
 	char *soname;
 
+	/* DT_PLTGOT, DT_JMPREL and DT_PLTRELSZ, used for lazy binding */
+	vaddr_t pltgot;
+	vaddr_t jmprel;
+	size_t pltrelsz;
+	/* DF_BIND_NOW or DF_1_BIND_NOW, all PLT entries are bound at load */
+	bool bind_now;
+
 	struct segment_head segs;
 
 	vaddr_t exidx_start;
@@ -106,6 +122,9 @@ void ta_elf_load_main(const TEE_UUID *uuid, uint32_t *is_32bit, uint64_t *sp,
 void ta_elf_finalize_load_main(uint64_t *entry);
 void ta_elf_load_dependency(struct ta_elf *elf, bool is_32bit);
 void ta_elf_relocate(struct ta_elf *elf);
+#ifdef ARM64
+vaddr_t ta_elf_lazy_resolve(struct ta_elf *elf, vaddr_t slot);
+#endif
 void ta_elf_finalize_mappings(struct ta_elf *elf);
 
 void ta_elf_print_mappings(void *pctx, print_func_t print_func,
@@ -5,6 +5,7 @@
 
 #include <assert.h>
 #include <compiler.h>
+#include <config.h>
 #include <confine_array_index.h>
 #include <elf32.h>
 #include <elf64.h>
@@ -78,9 +79,74 @@ static bool __resolve_sym(struct ta_elf *elf, unsigned int st_bind,
 	return true;
 }
 
-static TEE_Result resolve_sym_helper(uint32_t hash, const char *name,
-				     vaddr_t *val, struct ta_elf *elf,
-				     bool weak_ok)
+/*
+ * Symbol lookups during relocation are memoized in a small direct mapped
+ * cache indexed by the GNU hash of the name. Modules are only ever
+ * appended to main_elf_queue and a global lookup returns the first module
+ * in queue order defining the symbol, so a cached result stays valid
+ * until ldelf exits. The cached name points into the .dynstr of the
+ * module with the relocation which isn't unmapped either.
+ */
+#define SYM_CACHE_SIZE	64
+
+struct sym_cache_entry {
+	const char *name;
+	uint32_t hash;
+	struct ta_elf *elf;
+	vaddr_t val;
+};
+
+static struct sym_cache_entry sym_cache[SYM_CACHE_SIZE];
+
+struct sym_hash {
+	uint32_t gnu;
+	uint32_t sysv;
+	bool sysv_valid;
+};
+
+static uint32_t gnu_hash(const char *name)
+{
+	const unsigned char *p = (const unsigned char *)name;
+	uint32_t h = 5381;
+
+	while (*p)
+		h = (h << 5) + h + *p++;
+	return h;
+}
+
+static bool resolve_sym_idx(struct ta_elf *elf, size_t n, const char *name,
+			    vaddr_t *val, bool weak_ok)
+{
+	if (n >= elf->num_dynsyms)
+		err(TEE_ERROR_BAD_FORMAT, "Index out of range");
+	/*
+	 * We're loading values from sym[] which later will be used to
+	 * load something.
+	 * => Spectre V1 pattern, need to cap the index against
+	 * speculation.
+	 */
+	n = confine_array_index(n, elf->num_dynsyms);
+
+	if (elf->is_32bit) {
+		Elf32_Sym *sym = elf->dynsymtab;
+
+		return __resolve_sym(elf, ELF32_ST_BIND(sym[n].st_info),
+				     ELF32_ST_TYPE(sym[n].st_info),
+				     sym[n].st_shndx, sym[n].st_name,
+				     sym[n].st_value, name, val, weak_ok);
+	} else {
+		Elf64_Sym *sym = elf->dynsymtab;
+
+		return __resolve_sym(elf, ELF64_ST_BIND(sym[n].st_info),
+				     ELF64_ST_TYPE(sym[n].st_info),
+				     sym[n].st_shndx, sym[n].st_name,
+				     sym[n].st_value, name, val, weak_ok);
+	}
+}
+
+static TEE_Result sysv_resolve_sym_helper(uint32_t hash, const char *name,
+					  vaddr_t *val, struct ta_elf *elf,
+					  bool weak_ok)
 {
 	/*
 	 * Using uint32_t here for convenience because both Elf64_Word
@@ -93,85 +159,122 @@ static TEE_Result resolve_sym_helper(uint32_t hash, const char *name,
 	uint32_t *chain = &bucket[nbuckets];
 	size_t n = 0;
 
+	for (n = bucket[hash % nbuckets]; n; n = chain[n]) {
+		if (n >= nchains)
+			err(TEE_ERROR_BAD_FORMAT, "Index out of range");
+		if (resolve_sym_idx(elf, n, name, val, weak_ok))
+			return TEE_SUCCESS;
+	}
+
+	return TEE_ERROR_ITEM_NOT_FOUND;
+}
+
+/*
+ * Returns true if the Bloom filter of the DT_GNU_HASH table says that
+ * a symbol with @hash may be defined in @elf. The filter words are
+ * 32 or 64 bits depending on the ELF class.
+ */
+static bool gnu_bloom_match(struct ta_elf *elf, uint32_t hash)
+{
+	uint32_t *hashtab = elf->gnu_hashtab;
+	uint32_t bloom_size = hashtab[2];
+	uint32_t bloom_shift = hashtab[3];
+
 	if (elf->is_32bit) {
-		Elf32_Sym *sym = elf->dynsymtab;
+		uint32_t *bloom = &hashtab[4];
+		uint32_t word = bloom[(hash / 32) % bloom_size];
 
-		for (n = bucket[hash % nbuckets]; n; n = chain[n]) {
-			if (n >= nchains || n >= elf->num_dynsyms)
-				err(TEE_ERROR_BAD_FORMAT,
-				    "Index out of range");
-			/*
-			 * We're loading values from sym[] which later
-			 * will be used to load something.
-			 * => Spectre V1 pattern, need to cap the index
-			 * against speculation.
-			 */
-			n = confine_array_index(n, elf->num_dynsyms);
-			if (__resolve_sym(elf,
-					  ELF32_ST_BIND(sym[n].st_info),
-					  ELF32_ST_TYPE(sym[n].st_info),
-					  sym[n].st_shndx,
-					  sym[n].st_name,
-					  sym[n].st_value, name, val, weak_ok))
-				return TEE_SUCCESS;
-		}
+		return (word >> (hash % 32)) &
+		       (word >> ((hash >> bloom_shift) % 32)) & 1;
 	} else {
-		Elf64_Sym *sym = elf->dynsymtab;
+		uint64_t *bloom = (uint64_t *)&hashtab[4];
+		uint64_t word = bloom[(hash / 64) % bloom_size];
 
-		for (n = bucket[hash % nbuckets]; n; n = chain[n]) {
-			if (n >= nchains || n >= elf->num_dynsyms)
-				err(TEE_ERROR_BAD_FORMAT,
-				    "Index out of range");
-			/*
-			 * We're loading values from sym[] which later
-			 * will be used to load something.
-			 * => Spectre V1 pattern, need to cap the index
-			 * against speculation.
-			 */
-			n = confine_array_index(n, elf->num_dynsyms);
-			if (__resolve_sym(elf,
-					  ELF64_ST_BIND(sym[n].st_info),
-					  ELF64_ST_TYPE(sym[n].st_info),
-					  sym[n].st_shndx,
-					  sym[n].st_name,
-					  sym[n].st_value, name, val, weak_ok))
-				return TEE_SUCCESS;
-		}
+		return (word >> (hash % 64)) &
+		       (word >> ((hash >> bloom_shift) % 64)) & 1;
 	}
+}
+
+static TEE_Result gnu_resolve_sym_helper(uint32_t hash, const char *name,
+					 vaddr_t *val, struct ta_elf *elf,
+					 bool weak_ok)
+{
+	uint32_t *hashtab = elf->gnu_hashtab;
+	uint32_t nbuckets = hashtab[0];
+	uint32_t symoffset = hashtab[1];
+	size_t bloom_words = hashtab[2];
+	uint32_t *bucket = NULL;
+	uint32_t *chain = NULL;
+	uint32_t h = 0;
+	size_t n = 0;
+
+	if (!gnu_bloom_match(elf, hash))
+		return TEE_ERROR_ITEM_NOT_FOUND;
+
+	if (!elf->is_32bit)
+		bloom_words *= 2;
+	bucket = &hashtab[4 + bloom_words];
+	chain = &bucket[nbuckets];
+
+	n = bucket[hash % nbuckets];
+	if (!n)
+		return TEE_ERROR_ITEM_NOT_FOUND;
+
+	/*
+	 * Symbols in a bucket are consecutive in the symbol table, the
+	 * lowest bit of the chain hash marks the last one. The chain
+	 * array is indexed from symoffset.
+	 */
+	do {
+		if (n < symoffset || n >= elf->num_dynsyms)
+			err(TEE_ERROR_BAD_FORMAT, "Index out of range");
+		h = chain[n - symoffset];
+		if ((h | 1) == (hash | 1) &&
+		    resolve_sym_idx(elf, n, name, val, weak_ok))
+			return TEE_SUCCESS;
+		n++;
+	} while (!(h & 1));
 
 	return TEE_ERROR_ITEM_NOT_FOUND;
 }
 
-/*
- * Look for named symbol in @elf, or all modules if @elf == NULL. Global symbols
- * are searched first, then weak ones. Last option, when at least one weak but
- * undefined symbol exists, resolve to zero. Otherwise return
- * TEE_ERROR_ITEM_NOT_FOUND.
- * @val (if != 0) receives the symbol value
- * @found_elf (if != 0) receives the module where the symbol is found
- */
-TEE_Result ta_elf_resolve_sym(const char *name, vaddr_t *val,
-			      struct ta_elf **found_elf,
-			      struct ta_elf *elf)
+static TEE_Result resolve_sym_helper(struct sym_hash *hash, const char *name,
+				     vaddr_t *val, struct ta_elf *elf,
+				     bool weak_ok)
+{
+	if (elf->gnu_hashtab)
+		return gnu_resolve_sym_helper(hash->gnu, name, val, elf,
+					      weak_ok);
+
+	if (!hash->sysv_valid) {
+		hash->sysv = elf_hash(name);
+		hash->sysv_valid = true;
+	}
+	return sysv_resolve_sym_helper(hash->sysv, name, val, elf, weak_ok);
+}
+
+static TEE_Result resolve_sym_hashed(const char *name, uint32_t gnu_hash,
+				     vaddr_t *val, struct ta_elf **found_elf,
+				     struct ta_elf *elf)
 {
-	uint32_t hash = elf_hash(name);
+	struct sym_hash hash = { .gnu = gnu_hash };
 
 	if (elf) {
 		/* Search global symbols */
-		if (!resolve_sym_helper(hash, name, val, elf,
+		if (!resolve_sym_helper(&hash, name, val, elf,
 					false /* !weak_ok */))
 			goto success;
 		/* Search weak symbols */
-		if (!resolve_sym_helper(hash, name, val, elf,
+		if (!resolve_sym_helper(&hash, name, val, elf,
 					true /* weak_ok */))
 			goto success;
 	}
 
 	TAILQ_FOREACH(elf, &main_elf_queue, link) {
-		if (!resolve_sym_helper(hash, name, val, elf,
+		if (!resolve_sym_helper(&hash, name, val, elf,
 					false /* !weak_ok */))
 			goto success;
-		if (!resolve_sym_helper(hash, name, val, elf,
+		if (!resolve_sym_helper(&hash, name, val, elf,
 					true /* weak_ok */))
 			goto success;
 	}
@@ -184,6 +287,21 @@ success:
 	return TEE_SUCCESS;
 }
 
+/*
+ * Look for named symbol in @elf, or all modules if @elf == NULL. Global symbols
+ * are searched first, then weak ones. Last option, when at least one weak but
+ * undefined symbol exists, resolve to zero. Otherwise return
+ * TEE_ERROR_ITEM_NOT_FOUND.
+ * @val (if != 0) receives the symbol value
+ * @found_elf (if != 0) receives the module where the symbol is found
+ */
+TEE_Result ta_elf_resolve_sym(const char *name, vaddr_t *val,
+			      struct ta_elf **found_elf,
+			      struct ta_elf *elf)
+{
+	return resolve_sym_hashed(name, gnu_hash(name), val, found_elf, elf);
+}
+
 static void e32_get_sym_name(const Elf32_Sym *sym_tab, size_t num_syms,
 			     const char *str_tab, size_t str_tab_size,
 			     Elf32_Rel *rel, const char **name)
@@ -204,10 +322,24 @@ static void e32_get_sym_name(const Elf32_Sym *sym_tab, size_t num_syms,
 
 static void resolve_sym(const char *name, vaddr_t *val, struct ta_elf **mod)
 {
-	TEE_Result res = ta_elf_resolve_sym(name, val, mod, NULL);
+	uint32_t hash = gnu_hash(name);
+	struct sym_cache_entry *ce = sym_cache + hash % SYM_CACHE_SIZE;
+	TEE_Result res = TEE_ERROR_GENERIC;
+
+	if (!ce->name || ce->hash != hash || strcmp(ce->name, name)) {
+		res = resolve_sym_hashed(name, hash, &ce->val, &ce->elf, NULL);
+		if (res) {
+			ce->name = NULL;
+			err(res, "Symbol %s not found", name);
+		}
+		ce->name = name;
+		ce->hash = hash;
+	}
 
-	if (res)
-		err(res, "Symbol %s not found", name);
+	if (val)
+		*val = ce->val;
+	if (mod)
+		*mod = ce->elf;
 }
 
 static void e32_process_dyn_rel(const Elf32_Sym *sym_tab, size_t num_syms,
@@ -363,7 +495,8 @@ static void e32_relocate(struct ta_elf *elf, unsigned int rel_sidx)
 			*where += sym_tab[sym_idx].st_value - rel->r_offset;
 			break;
 		case R_ARM_RELATIVE:
-			*where += elf->load_addr;
+			/* A prelinked value already includes prelink_base */
+			*where += elf->load_addr - elf->prelink_base;
 			break;
 		case R_ARM_GLOB_DAT:
 		case R_ARM_JUMP_SLOT:
@@ -480,7 +613,7 @@ static void e64_process_tlsdesc_rela(const Elf64_Sym *sym_tab, size_t num_syms,
 				   rela, where + 1, elf);
 }
 
-static void e64_relocate(struct ta_elf *elf, unsigned int rel_sidx)
+static void e64_relocate(struct ta_elf *elf, unsigned int rel_sidx, bool lazy)
 {
 	Elf64_Shdr *shdr = elf->shdr;
 	Elf64_Rela *rela = NULL;
@@ -586,8 +719,17 @@ static void e64_relocate(struct ta_elf *elf, unsigned int rel_sidx)
 		case R_AARCH64_RELATIVE:
 			*where = rela->r_addend + elf->load_addr;
 			break;
-		case R_AARCH64_GLOB_DAT:
 		case R_AARCH64_JUMP_SLOT:
+			if (lazy) {
+				/*
+				 * The GOT entry points to the first PLT
+				 * entry which calls plt_lazy_resolve().
+				 */
+				*where += elf->load_addr;
+				break;
+			}
+			fallthrough;
+		case R_AARCH64_GLOB_DAT:
 			e64_process_dyn_rela(sym_tab, num_syms, str_tab,
 					     str_tab_size, rela, where);
 			break;
@@ -607,14 +749,171 @@ static void e64_relocate(struct ta_elf *elf, unsigned int rel_sidx)
 		}
 	}
 }
+
+/* Entered from the first PLT entry, see plt_lazy_resolve_a64.S */
+void plt_lazy_resolve(void);
+
+static bool lazy_binding(struct ta_elf *elf)
+{
+	/* A TA linked with -z now has all modules bound at load */
+	struct ta_elf *ta = TAILQ_FIRST(&main_elf_queue);
+
+	return IS_ENABLED(CFG_TA_LAZY_BINDING) && elf->pltgot &&
+	       elf->jmprel && !elf->bind_now && !ta->bind_now;
+}
+
+static void set_lazy_resolver(struct ta_elf *elf)
+{
+	Elf64_Addr *got = (Elf64_Addr *)elf->pltgot;
+
+	/*
+	 * The first PLT entry pushes x16 (&GOT[n]) and x30 and branches
+	 * to GOT[2] with &GOT[2] in x16, GOT[1] identifies the module.
+	 */
+	got[1] = (vaddr_t)elf;
+	got[2] = (vaddr_t)plt_lazy_resolve;
+}
+
+/*
+ * Called from plt_lazy_resolve() on the stack of the TA when the PLT entry
+ * with the GOT entry @slot is called for the first time. Returns the
+ * address of the function which also is stored in the GOT entry.
+ */
+vaddr_t ta_elf_lazy_resolve(struct ta_elf *elf, vaddr_t slot)
+{
+	Elf64_Rela *rela = (Elf64_Rela *)elf->jmprel;
+	size_t num_relas = elf->pltrelsz / sizeof(Elf64_Rela);
+	const char *name = NULL;
+	vaddr_t val = 0;
+	size_t n = 0;
+
+	sys_in_ta_context = true;
+
+	/*
+	 * JUMP_SLOT relocations come in the same order as the PLT and GOT
+	 * entries, following the three reserved words in the GOT.
+	 */
+	n = (slot - elf->pltgot) / sizeof(Elf64_Addr) - 3;
+	if (slot < elf->pltgot || n >= num_relas)
+		err(TEE_ERROR_BAD_FORMAT, "GOT entry %#"PRIxVA" out of range",
+		    slot);
+	n = confine_array_index(n, num_relas);
+	if (ELF64_R_TYPE(rela[n].r_info) != R_AARCH64_JUMP_SLOT ||
+	    rela[n].r_offset + elf->load_addr != slot)
+		err(TEE_ERROR_BAD_FORMAT, "No JUMP_SLOT for GOT entry %#"PRIxVA,
+		    slot);
+
+	e64_get_sym_name(elf->dynsymtab, elf->num_dynsyms, elf->dynstr,
+			 elf->dynstr_size, rela + n, &name);
+	resolve_sym(name, &val, NULL);
+	*(Elf64_Addr *)slot = val;
+
+	sys_in_ta_context = false;
+
+	return val;
+}
 #else /*ARM64*/
 static void __noreturn e64_relocate(struct ta_elf *elf __unused,
-				    unsigned int rel_sidx __unused)
+				    unsigned int rel_sidx __unused,
+				    bool lazy __unused)
 {
 	err(TEE_ERROR_NOT_SUPPORTED, "arm64 not supported");
 }
+
+static bool lazy_binding(struct ta_elf *elf __unused)
+{
+	return false;
+}
+
+static void set_lazy_resolver(struct ta_elf *elf __unused)
+{
+}
 #endif /*ARM64*/
 
+static void relr_apply(struct ta_elf *elf, size_t offs, size_t word_size,
+		       vaddr_t delta)
+{
+	size_t end = 0;
+
+	if (ADD_OVERFLOW(offs, word_size, &end) ||
+	    end > elf->max_addr - elf->load_addr)
+		err(TEE_ERROR_BAD_FORMAT, "Relocation offset out of range");
+
+	if (word_size == sizeof(uint32_t))
+		*(uint32_t *)(elf->load_addr + offs) += delta;
+	else
+		*(uint64_t *)(elf->load_addr + offs) += delta;
+}
+
+/*
+ * Processes a SHT_RELR section, relative relocations encoded as a list of
+ * words. An even word is the offset of a word to relocate. An odd word is
+ * a bitmap where bit n, n > 0, selects the word n - 1 words after the last
+ * word covered by the previous entry.
+ *
+ * The words to relocate hold the address they refer to when loaded at
+ * prelink_base, which is 0 unless sign_encrypt.py --prelink-base was used.
+ * The whole table is skipped if the ELF is loaded at its prelink base.
+ */
+static void relocate_relr(struct ta_elf *elf, unsigned int rel_sidx)
+{
+	size_t word_size = sizeof(uint64_t);
+	vaddr_t delta = elf->load_addr - elf->prelink_base;
+	size_t sh_addr = 0;
+	size_t sh_size = 0;
+	size_t sh_end = 0;
+	size_t offs = 0;
+	size_t num = 0;
+	size_t n = 0;
+
+	if (elf->is_32bit) {
+		Elf32_Shdr *shdr = elf->shdr;
+
+		word_size = sizeof(uint32_t);
+		sh_addr = shdr[rel_sidx].sh_addr;
+		sh_size = shdr[rel_sidx].sh_size;
+	} else {
+		Elf64_Shdr *shdr = elf->shdr;
+
+		sh_addr = shdr[rel_sidx].sh_addr;
+		sh_size = shdr[rel_sidx].sh_size;
+	}
+
+	if (!delta)
+		return;
+
+	/* Check the address is inside TA memory */
+	if (ADD_OVERFLOW(sh_addr, sh_size, &sh_end))
+		err(TEE_ERROR_BAD_FORMAT, "Overflow");
+	if (sh_end >= (elf->max_addr - elf->load_addr))
+		err(TEE_ERROR_BAD_FORMAT, ".relr.dyn out of range");
+	if (sh_addr & (word_size - 1))
+		err(TEE_ERROR_BAD_FORMAT, "Bad alignment of .relr.dyn");
+
+	num = sh_size / word_size;
+	for (n = 0; n < num; n++) {
+		vaddr_t va = elf->load_addr + sh_addr + n * word_size;
+		uint64_t ent = 0;
+		size_t o = 0;
+
+		if (elf->is_32bit)
+			ent = *(uint32_t *)va;
+		else
+			ent = *(uint64_t *)va;
+
+		if (!(ent & 1)) {
+			relr_apply(elf, ent, word_size, delta);
+			offs = ent + word_size;
+			continue;
+		}
+
+		for (o = offs, ent >>= 1; ent; o += word_size, ent >>= 1)
+			if (ent & 1)
+				relr_apply(elf, o, word_size, delta);
+		offs += (word_size * 8 - 1) * word_size;
+	}
+}
+
 void ta_elf_relocate(struct ta_elf *elf)
 {
 	size_t n = 0;
@@ -625,12 +924,19 @@ void ta_elf_relocate(struct ta_elf *elf)
 		for (n = 0; n < elf->e_shnum; n++)
 			if (shdr[n].sh_type == SHT_REL)
 				e32_relocate(elf, n);
+			else if (shdr[n].sh_type == SHT_RELR)
+				relocate_relr(elf, n);
 	} else {
 		Elf64_Shdr *shdr = elf->shdr;
+		bool lazy = lazy_binding(elf);
 
 		for (n = 0; n < elf->e_shnum; n++)
 			if (shdr[n].sh_type == SHT_RELA)
-				e64_relocate(elf, n);
+				e64_relocate(elf, n, lazy);
+			else if (shdr[n].sh_type == SHT_RELR)
+				relocate_relr(elf, n);
 
+		if (lazy)
+			set_lazy_resolver(elf);
 	}
 }
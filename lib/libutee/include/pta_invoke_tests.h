@@ -103,5 +103,17 @@
  */
 #define PTA_INVOKE_TESTS_CMD_MEMREF_NULL	10
 
+/*
+ * Tests rwlock, used as PTA_INVOKE_TESTS_CMD_MUTEX
+ *
+ * [in]  value[0].a	Test function PTA_RWLOCK_TEST_*
+ * [in]  value[0].b	delay number
+ * [out] value[1].a	before lock concurency
+ * [out] value[1].b	during lock concurency
+ */
+#define PTA_RWLOCK_TEST_WRITER			0
+#define PTA_RWLOCK_TEST_READER			1
+#define PTA_INVOKE_TESTS_CMD_RWLOCK		11
+
 #endif /*__PTA_INVOKE_TESTS_H*/
 
@@ -41,6 +41,23 @@ struct ta_head {
 	uint64_t depr_entry;
 };
 
+/*
+ * ELF note in the first page of a TA built with CFG_TA_PRELINK=y. The
+ * descriptor is the 64-bit little endian address the TA is prelinked at,
+ * written by sign_encrypt.py --prelink-base, or 0 if not prelinked.
+ */
+#define TA_PRELINK_NOTE_NAME		"OP-TEE"
+#define TA_PRELINK_NOTE_TYPE		1
+
+struct ta_prelink_note {
+	uint32_t namesz;
+	uint32_t descsz;
+	uint32_t type;
+	char name[8];
+	uint32_t base_lo;
+	uint32_t base_hi;
+};
+
 #if defined(CFG_FTRACE_SUPPORT)
 #define FTRACE_RETFUNC_DEPTH		50
 union compat_ptr {
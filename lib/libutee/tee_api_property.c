@@ -31,6 +31,21 @@ struct prop_enumerator {
 	TEE_PropSetHandle prop_set;	/* part of TEE_PROPSET_xxx */
 };
 
+/*
+ * Properties of a property table sorted by name, built on first lookup.
+ * The table itself is left untouched since its order is the enumeration
+ * order. The array of pointers is allocated from the TA heap and never
+ * freed, it's charged to the TA heap for the lifetime of the instance.
+ */
+struct prop_sorted {
+	const struct user_ta_property **props;
+	size_t len;
+	bool initialized;
+};
+
+static struct prop_sorted ta_props_sorted;
+static struct prop_sorted tee_props_sorted;
+
 const struct user_ta_property tee_props[] = {
 	{
 		"gpd.tee.arith.maxBigIntSize",
@@ -79,6 +94,85 @@ static TEE_Result propset_get(TEE_PropSetHandle h,
 	return TEE_SUCCESS;
 }
 
+static int cmp_prop_name(const void *a, const void *b)
+{
+	const struct user_ta_property * const *pa = a;
+	const struct user_ta_property * const *pb = b;
+	int r = strcmp((*pa)->name, (*pb)->name);
+
+	/* Keep duplicates in table order, the first one wins */
+	if (r)
+		return r;
+	return CMP_TRILEAN(*pa, *pb);
+}
+
+static struct prop_sorted *get_sorted(TEE_PropSetHandle h,
+				      const struct user_ta_property *eps,
+				      size_t eps_len)
+{
+	struct prop_sorted *ps = NULL;
+	size_t n = 0;
+
+	if (h == TEE_PROPSET_CURRENT_TA)
+		ps = &ta_props_sorted;
+	else if (h == TEE_PROPSET_TEE_IMPLEMENTATION)
+		ps = &tee_props_sorted;
+	else
+		return NULL;
+
+	if (!ps->initialized) {
+		ps->initialized = true;
+		if (eps_len < 2)
+			return NULL;
+		ps->props = TEE_Malloc(eps_len * sizeof(*ps->props),
+				       TEE_USER_MEM_HINT_NO_FILL_ZERO);
+		if (!ps->props)
+			return NULL;
+		for (n = 0; n < eps_len; n++)
+			ps->props[n] = eps + n;
+		qsort(ps->props, eps_len, sizeof(*ps->props), cmp_prop_name);
+		ps->len = eps_len;
+	}
+
+	if (!ps->props)
+		return NULL;
+	return ps;
+}
+
+/*
+ * Returns the property named @name in @eps or NULL if not found. Falls
+ * back to a linear search if the sorted view can't be allocated.
+ */
+static const struct user_ta_property *
+find_ext_prop(TEE_PropSetHandle h, const struct user_ta_property *eps,
+	      size_t eps_len, const char *name)
+{
+	struct prop_sorted *ps = get_sorted(h, eps, eps_len);
+	size_t lo = 0;
+	size_t hi = 0;
+	size_t n = 0;
+
+	if (!ps) {
+		for (n = 0; n < eps_len; n++)
+			if (!strcmp(name, eps[n].name))
+				return eps + n;
+		return NULL;
+	}
+
+	hi = ps->len;
+	while (lo < hi) {
+		n = lo + (hi - lo) / 2;
+		if (strcmp(ps->props[n]->name, name) < 0)
+			lo = n + 1;
+		else
+			hi = n;
+	}
+
+	if (lo < ps->len && !strcmp(ps->props[lo]->name, name))
+		return ps->props[lo];
+	return NULL;
+}
+
 static TEE_Result propget_get_ext_prop(const struct user_ta_property *ep,
 				       enum user_ta_prop_type *type,
 				       void *buf, uint32_t *len)
@@ -153,17 +247,15 @@ static TEE_Result propget_get_property(TEE_PropSetHandle h, const char *name,
 	uint32_t index;
 
 	if (is_propset_pseudo_handle(h)) {
-		size_t n;
+		const struct user_ta_property *ep = NULL;
 
 		res = propset_get(h, &eps, &eps_len);
 		if (res != TEE_SUCCESS)
 			return res;
 
-		for (n = 0; n < eps_len; n++) {
-			if (!strcmp(name, eps[n].name))
-				return propget_get_ext_prop(eps + n, type,
-							    buf, len);
-		}
+		ep = find_ext_prop(h, eps, eps_len, name);
+		if (ep)
+			return propget_get_ext_prop(ep, type, buf, len);
 
 		/* get the index from the name */
 		res = _utee_get_property_name_to_index((unsigned long)h, name,
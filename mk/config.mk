@@ -290,6 +290,28 @@ CFG_TA_ASLR ?= y
 CFG_TA_ASLR_MIN_OFFSET_PAGES ?= 0
 CFG_TA_ASLR_MAX_OFFSET_PAGES ?= 128
 
+# Lazy binding of PLT entries in 64-bit user TAs and shared libraries
+#
+# When this flag is enabled, ldelf leaves the JUMP_SLOT relocations
+# unresolved at load and binds each PLT entry on its first call. TAs only
+# calling a fraction of their imported functions load faster, but a
+# missing symbol panics the TA when first called instead of failing the
+# load. A TA linked with "-z now", see
+# CFG_TA_BIND_NOW in ta/arch/arm/link.mk, has all its modules bound at
+# load regardless of this flag.
+CFG_TA_LAZY_BINDING ?= n
+
+# Prelinked user TAs
+#
+# CFG_TA_PRELINK=y and CFG_TA_PRELINK_BASE=<address>, set when building a
+# TA like CFG_TA_BIND_NOW, have sign_encrypt.py apply the relative
+# relocations of the TA for CFG_TA_PRELINK_BASE when the TA is signed. The
+# base is recorded in an OP-TEE ELF note in the first page of the TA, ELF
+# files without that note are never treated as prelinked. With
+# CFG_TA_ASLR=n ldelf tries to map a prelinked TA at its base and skips
+# the relative relocations if that succeeds, otherwise they're applied as
+# usual.
+
 # Address Space Layout Randomization for TEE Core
 #
 # When this flag is enabled, the early init code will introduce a random
@@ -310,6 +332,25 @@ CFG_REE_FS_TA ?= y
 CFG_REE_FS_TA_BUFFERED ?= n
 $(eval $(call cfg-depends-all,CFG_REE_FS_TA_BUFFERED,CFG_REE_FS_TA))
 
+# Number of verified TA images kept in the "Secure DDR" pool after the
+# last session using them is closed, when CFG_REE_FS_TA_BUFFERED=y. A TA
+# found in the cache is opened without loading it from normal world or
+# checking its signature again. The least recently used image is dropped
+# when the cache is full, and the image of a TA is dropped when the TA is
+# installed in secure storage or its rollback version is updated.
+# 0 disables the cache.
+CFG_REE_FS_TA_CACHE_ENTRIES ?= 0
+
+# Number of TA binaries, identified by their tag, whose read-only segments
+# are kept in TA RAM after the last instance using them is gone, so that
+# a later instance or another TA using the same shared library maps the
+# same physical pages instead of allocating and copying its own. Only
+# binaries which were completely verified while populating the segments
+# are kept. Cached segments no one uses are released when TA RAM runs
+# out. 0 disables the cache, segments are then only shared between
+# instances loaded at the same time.
+CFG_CORE_FILE_CACHE_ENTRIES ?= 0
+
 # When CFG_REE_FS=y and CFG_RPMB_FS=y:
 # Allow secure storage in the REE FS to be entirely deleted without causing
 # anti-rollback errors. That is, rm /data/tee/dirf.db or rm -rf /data/tee (or
@@ -367,6 +408,31 @@ endif
 # not compress them with CFG_EARLY_TA_COMPRESS=n
 CFG_EARLY_TA_COMPRESS ?= y
 
+# When enabled TEE core accepts TA images signed with
+# sign_encrypt.py --compress (SHDR_COMPRESSED_TA) from the REE FS and the
+# secure storage TA stores. The image is inflated while it is loaded and the
+# signature covers the compressed image. TAs are signed compressed when
+# they are built with CFG_COMPRESS_TA=y.
+CFG_TA_COMPRESSED_IMAGES ?= n
+ifeq ($(CFG_TA_COMPRESSED_IMAGES),y)
+$(call force,CFG_ZLIB,y)
+endif
+
+# CFG_TA_IDLE_POOL_SIZE, when non-zero, keeps up to this many pre-loaded
+# user TA instances: when the last session of an instance is closed the
+# instance is unloaded as usual and a fresh instance of the TA is loaded,
+# but not entered, in its place. The next session to the TA then gets that
+# instance without waiting for it to be loaded, as a new instance which was
+# never used. The least recently loaded instance is unloaded first and at
+# most CFG_TA_IDLE_POOL_PER_UUID instances of a given TA are kept.
+# The fresh instance is loaded synchronously by the thread closing the
+# session, so closing the last session of an instance takes as long as
+# loading the TA. A TA updated in normal world is only noticed once its
+# idle instances are gone. Idle instances are unloaded when allocating TA
+# memory fails, and when the TA is installed in secure storage.
+CFG_TA_IDLE_POOL_SIZE ?= 0
+CFG_TA_IDLE_POOL_PER_UUID ?= 1
+
 # Enable paging, requires SRAM, can't be enabled by default
 CFG_WITH_PAGER ?= n
 
@@ -387,6 +453,22 @@ CFG_CORE_PAGE_TAG_AND_IV ?= $(CFG_PAGED_USER_TA)
 CFG_LOCKDEP ?= n
 CFG_LOCKDEP_RECORD_STACK ?= y
 
+# Lock contention profiler: when enabled together with CFG_LOCKDEP, every
+# mutex in the lock graph also records the number of acquisitions and of
+# contended acquisitions, the total time spent waiting for and holding
+# it, and the call sites most often found waiting for it. The result is
+# printed by the stats pseudo TA.
+CFG_LOCKDEP_PROFILE ?= n
+$(eval $(call cfg-depends-all,CFG_LOCKDEP_PROFILE,CFG_LOCKDEP))
+
+# Adaptive mutex spinning: when a mutex is write locked by a thread which
+# is currently executing on another core, mutex_lock() polls the mutex up to
+# CFG_MUTEX_SPIN_BUDGET times before going to sleep in normal world. This
+# saves the two world switches needed to sleep and be woken up when the
+# lock is held only briefly, 1000 is a reasonable budget to start with.
+# The default 0 disables spinning, mutex_lock() always sleeps directly.
+CFG_MUTEX_SPIN_BUDGET ?= 0
+
 # BestFit algorithm in bget reduces the fragmentation of the heap when running
 # with the pager enabled or lockdep
 CFG_CORE_BGET_BESTFIT ?= $(call cfg-one-enabled, CFG_WITH_PAGER CFG_LOCKDEP)
@@ -799,5 +881,11 @@ endif
 # CFG_CORE_ASYNC_NOTIF_GIC_INTID defined.
 CFG_CORE_ASYNC_NOTIF ?= n
 
+# CFG_CORE_INVOKE_BATCH enables OPTEE_MSG_CMD_INVOKE_BATCH, several invoke
+# commands executed with a single standard call. The capability is
+# advertised with OPTEE_SMC_SEC_CAP_INVOKE_BATCH, which is an extension
+# normal world drivers must know about.
+CFG_CORE_INVOKE_BATCH ?= n
+
 $(eval $(call cfg-enable-all-depends,CFG_MEMPOOL_REPORT_LAST_OFFSET, \
 	 CFG_WITH_STATS))
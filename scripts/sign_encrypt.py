@@ -16,6 +16,8 @@ enc_key_type = {'SHDR_ENC_KEY_DEV_SPECIFIC': 0x0,
 
 SHDR_BOOTSTRAP_TA = 1
 SHDR_ENCRYPTED_TA = 2
+SHDR_COMPRESSED_TA = 3
+SHDR_COMP_ALGO_ZLIB = 0
 SHDR_MAGIC = 0x4f545348
 SHDR_SIZE = 20
 
@@ -29,6 +31,133 @@ def int_parse(str):
     return int(str, 0)
 
 
+def prelink_elf(img, base):
+    """Returns a copy of the ELF image img prelinked at address base
+
+    The relative relocations in SHT_RELR sections, and R_ARM_RELATIVE
+    relocations in SHT_REL sections of 32-bit ELFs, are applied for base.
+    base is recorded in the OP-TEE prelink note, which is only present in
+    TAs built with CFG_TA_PRELINK=y. It tells ldelf that it only needs to
+    process the relative relocations if the ELF is loaded elsewhere.
+    """
+    import struct
+
+    PT_LOAD = 1
+    PT_NOTE = 4
+    NT_OPTEE_PRELINK = 1
+    NOTE_NAME = b'OP-TEE\x00'
+    SHT_REL = 9
+    SHT_RELR = 19
+    R_ARM_RELATIVE = 23
+
+    img = bytearray(img)
+    if img[:4] != b'\x7fELF' or img[5] != 1:
+        raise ValueError('Not a little endian ELF file')
+    if base & 0xfff:
+        raise ValueError('Prelink base must be 4 KiB aligned')
+
+    is_32bit = img[4] == 1
+    if is_32bit:
+        word = 'I'
+        phoff, shoff = struct.unpack_from('<II', img, 28)
+        phentsize, phnum, shentsize, shnum = struct.unpack_from('<HHHH',
+                                                                 img, 42)
+        phdr_fmt = '<IIIIII'
+        shdr_fmt = '<IIIIII'
+    else:
+        word = 'Q'
+        phoff, shoff = struct.unpack_from('<QQ', img, 32)
+        phentsize, phnum, shentsize, shnum = struct.unpack_from('<HHHH',
+                                                                 img, 54)
+        phdr_fmt = '<IIQQQQ'
+        shdr_fmt = '<IIQQQQ'
+    word_size = struct.calcsize(word)
+    word_mask = (1 << (word_size * 8)) - 1
+
+    def find_prelink_note(offs, size):
+        # ldelf only looks at the notes in the first page
+        if offs + size > 4096:
+            return None
+        while size >= 12:
+            namesz, descsz, n_type = struct.unpack_from('<III', img, offs)
+            sz = 12 + (namesz + 3) // 4 * 4 + (descsz + 3) // 4 * 4
+            if sz > size:
+                return None
+            name = bytes(img[offs + 12:offs + 12 + namesz])
+            if (n_type == NT_OPTEE_PRELINK and name == NOTE_NAME and
+                    descsz == 8):
+                return offs + 12 + (namesz + 3) // 4 * 4
+            offs += sz
+            size -= sz
+        return None
+
+    segs = []
+    note_desc = None
+    for n in range(phnum):
+        offs = phoff + n * phentsize
+        if is_32bit:
+            (p_type, p_offset, p_vaddr, _, p_filesz,
+             _) = struct.unpack_from(phdr_fmt, img, offs)
+        else:
+            (p_type, _, p_offset, p_vaddr, _,
+             p_filesz) = struct.unpack_from(phdr_fmt, img, offs)
+        if p_type == PT_LOAD:
+            segs.append((p_vaddr, p_offset, p_filesz))
+        elif p_type == PT_NOTE and note_desc is None:
+            note_desc = find_prelink_note(p_offset, p_filesz)
+
+    if note_desc is None:
+        raise ValueError('No prelink note, the TA must be built with ' +
+                         'CFG_TA_PRELINK=y')
+    if struct.unpack_from('<Q', img, note_desc)[0]:
+        raise ValueError('ELF file is already prelinked')
+    struct.pack_into('<Q', img, note_desc, base)
+
+    def apply(vaddr):
+        for (s_vaddr, s_offset, s_filesz) in segs:
+            if vaddr >= s_vaddr and vaddr + word_size <= s_vaddr + s_filesz:
+                offs = s_offset + vaddr - s_vaddr
+                val, = struct.unpack_from('<' + word, img, offs)
+                struct.pack_into('<' + word, img, offs,
+                                 (val + base) & word_mask)
+                return
+        raise ValueError('Relocation at {:#x} not in a loaded segment'
+                         .format(vaddr))
+
+    have_relr = False
+    for n in range(shnum):
+        offs = shoff + n * shentsize
+        (_, sh_type, _, _, sh_offset,
+         sh_size) = struct.unpack_from(shdr_fmt, img, offs)
+
+        if sh_type == SHT_RELR:
+            have_relr = True
+            where = 0
+            for i in range(sh_size // word_size):
+                ent, = struct.unpack_from('<' + word, img,
+                                          sh_offset + i * word_size)
+                if not ent & 1:
+                    apply(ent)
+                    where = ent + word_size
+                    continue
+                for bit in range(1, word_size * 8):
+                    if ent >> bit & 1:
+                        apply(where + (bit - 1) * word_size)
+                where += (word_size * 8 - 1) * word_size
+        elif sh_type == SHT_REL and is_32bit:
+            for i in range(sh_size // 8):
+                r_offset, r_info = struct.unpack_from('<II', img,
+                                                      sh_offset + i * 8)
+                if r_info & 0xff == R_ARM_RELATIVE:
+                    apply(r_offset)
+
+    if not have_relr and not is_32bit:
+        raise ValueError('No SHT_RELR section, the ELF file must be ' +
+                         'linked with -z pack-relative-relocs')
+
+    return bytes(img)
+
+
 def get_args(logger):
     from argparse import ArgumentParser, RawDescriptionHelpFormatter
     import textwrap
@@ -109,6 +238,15 @@ def get_args(logger):
         help='Encryption key type.\n' +
         '(SHDR_ENC_KEY_DEV_SPECIFIC or SHDR_ENC_KEY_CLASS_WIDE).\n' +
         'Defaults to SHDR_ENC_KEY_DEV_SPECIFIC.')
+    parser.add_argument(
+        '--compress', required=False, action='store_true',
+        help='Compress the TA with zlib, the TA is inflated by TEE core\n' +
+        'while it is loaded. Cannot be combined with --enc-key.')
+    parser.add_argument(
+        '--prelink-base', required=False, type=int_parse,
+        help='Prelink the TA at this address before signing, ldelf skips\n' +
+        'the relative relocations when the TA is loaded there. The TA\n' +
+        'must be linked with -z pack-relative-relocs if it is 64-bit.')
     parser.add_argument(
         '--ta-version', required=False, type=int_parse, default=0,
         help='TA version stored as a 32-bit unsigned integer and used for\n' +
@@ -204,12 +342,28 @@ def main():
     with open(args.inf, 'rb') as f:
         img = f.read()
 
+    if args.prelink_base:
+        try:
+            img = prelink_elf(img, args.prelink_base)
+        except ValueError as e:
+            logger.error('Cannot prelink {}: {}'.format(args.inf, e))
+            sys.exit(1)
+
     chosen_hash = hashes.SHA256()
     h = hashes.Hash(chosen_hash, default_backend())
 
     digest_len = chosen_hash.digest_size
     sig_len = math.ceil(key.key_size / 8)
 
+    if args.compress:
+        if args.enc_key:
+            logger.error('--compress cannot be combined with --enc-key')
+            sys.exit(1)
+        import zlib
+        # struct shdr_compressed_ta
+        chdr = struct.pack('<II', SHDR_COMP_ALGO_ZLIB, len(img))
+        img = zlib.compress(img, 9)
+
     img_size = len(img)
 
     hdr_version = args.ta_version  # struct shdr_bootstrap_ta::ta_version
@@ -217,6 +371,8 @@ def main():
     magic = SHDR_MAGIC
     if args.enc_key:
         img_type = SHDR_ENCRYPTED_TA
+    elif args.compress:
+        img_type = SHDR_COMPRESSED_TA
     else:
         img_type = SHDR_BOOTSTRAP_TA
 
@@ -248,6 +404,8 @@ def main():
         h.update(ehdr)
         h.update(nonce)
         h.update(tag)
+    if args.compress:
+        h.update(chdr)
     h.update(img)
     img_digest = h.finalize()
 
@@ -264,6 +422,8 @@ def main():
                 f.write(tag)
                 f.write(ciphertext)
             else:
+                if args.compress:
+                    f.write(chdr)
                 f.write(img)
 
     def sign_encrypt_ta():
@@ -361,7 +521,7 @@ def main():
         if magic != SHDR_MAGIC:
             raise Exception("Unexpected magic: 0x{:08x}".format(magic))
 
-        if img_type != SHDR_BOOTSTRAP_TA:
+        if img_type not in (SHDR_BOOTSTRAP_TA, SHDR_COMPRESSED_TA):
             raise Exception("Unsupported image type: {}".format(img_type))
 
         if algo_value not in algo.values():
@@ -395,6 +555,11 @@ def main():
         # sizeof(struct shdr_bootstrap_ta)
         h.update(img[start:end])
 
+        if img_type == SHDR_COMPRESSED_TA:
+            # sizeof(struct shdr_compressed_ta)
+            start, end = end, end + 8
+            h.update(img[start:end])
+
         # raw image
         start = end
         end += img_size
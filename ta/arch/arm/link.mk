@@ -16,6 +16,17 @@ ifeq ($(CFG_ENCRYPT_TA),y)
 TA_ENC_KEY ?= 'b64d239b1f3c7d3b06506229cd8ff7c8af2bb4db2168621ac62c84948468c4f4'
 endif
 
+ifeq ($(CFG_TA_PRELINK),y)
+# Prelinking applies the relative relocations for a TA loaded at
+# CFG_TA_PRELINK_BASE when it is signed. When ldelf manages to map the TA
+# there, which requires CFG_TA_ASLR=n, the relocations are skipped at load.
+# Elsewhere they're applied as usual, so a base which doesn't match the
+# layout of the TA address space only costs the saved time.
+ifeq ($(CFG_TA_PRELINK_BASE),)
+$(error CFG_TA_PRELINK=y requires CFG_TA_PRELINK_BASE)
+endif
+endif
+
 all: $(link-out-dir$(sm))/$(user-ta-uuid).dmp \
 	$(link-out-dir$(sm))/$(user-ta-uuid).stripped.elf \
 	$(link-out-dir$(sm))/$(user-ta-uuid).ta
@@ -35,6 +46,18 @@ ifeq ($(sm)-$(CFG_TA_BTI),ta_arm64-y)
 link-ldflags += $(call ld-option,-z force-bti) --fatal-warnings
 endif
 link-ldflags += --as-needed # Do not add dependency on unused shlib
+# DT_GNU_HASH for faster symbol lookup, DT_HASH for older versions of ldelf
+link-ldflags += --hash-style=both
+ifeq ($(CFG_TA_BIND_NOW),y)
+# Bind all PLT entries of the TA and its libraries at load even if ldelf
+# supports lazy binding, see CFG_TA_LAZY_BINDING
+link-ldflags += -z now
+endif
+ifeq ($(CFG_TA_PRELINK),y)
+# Compact DT_RELR table of the relative relocations, required by
+# sign_encrypt.py --prelink-base for 64-bit TAs
+link-ldflags += $(call ld-option,-z pack-relative-relocs)
+endif
 link-ldflags += $(link-ldflags$(sm))
 
 $(link-out-dir$(sm))/dyn_list:
@@ -106,6 +129,12 @@ ifeq ($(CFG_ENCRYPT_TA),y)
 crypt-args$(user-ta-uuid) := --enc-key $(TA_ENC_KEY)
 cmd-echo$(user-ta-uuid) := SIGNENC
 endif
+ifeq ($(CFG_COMPRESS_TA),y)
+crypt-args$(user-ta-uuid) += --compress
+endif
+ifeq ($(CFG_TA_PRELINK),y)
+crypt-args$(user-ta-uuid) += --prelink-base $(CFG_TA_PRELINK_BASE)
+endif
 $(link-out-dir$(sm))/$(user-ta-uuid).ta: \
 			$(link-out-dir$(sm))/$(user-ta-uuid).stripped.elf \
 			$(TA_SIGN_KEY) \
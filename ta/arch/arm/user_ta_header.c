@@ -90,6 +90,17 @@ const struct ta_head ta_head __section(".ta_head") = {
 	.depr_entry = UINT64_MAX,
 };
 
+#ifdef CFG_TA_PRELINK
+/* Placed in the first page of the TA by ta.ld.S, see ldelf */
+const struct ta_prelink_note ta_prelink_note
+	__section(".note.optee.prelink") __aligned(4) __used = {
+	.namesz = sizeof(TA_PRELINK_NOTE_NAME),
+	.descsz = sizeof(uint32_t) * 2,
+	.type = TA_PRELINK_NOTE_TYPE,
+	.name = TA_PRELINK_NOTE_NAME,
+};
+#endif
+
 /* Keeping the heap in bss */
 #if TA_DATA_SIZE < MALLOC_INITIAL_POOL_MIN_SIZE
 #error TA_DATA_SIZE too small
@@ -26,44 +26,117 @@ void handle_db_destroy(struct handle_db *db)
 {
 	if (db) {
 		TEE_Free(db->ptrs);
-		db->ptrs = NULL;
-		db->max_ptrs = 0;
+		TEE_Free(db->free_idx);
+		TEE_Free(db->hash_head);
+		TEE_Free(db->hash_next);
+		handle_db_init(db);
 	}
 }
 
-uint32_t handle_get(struct handle_db *db, void *ptr)
+static uint32_t hash_ptr(struct handle_db *db, void *ptr)
 {
-	uint32_t n = 0;
-	void *p = NULL;
-	uint32_t new_max_ptrs = 0;
+	uintptr_t h = (uintptr_t)ptr;
 
-	if (!db || !ptr)
-		return 0;
+	/* Low bits of heap pointers carry little information */
+	h = (h >> 4) ^ (h >> 12);
+	return h & (db->max_ptrs - 1);
+}
 
-	/* Try to find an empty location (index 0 is reserved as invalid) */
-	for (n = 1; n < db->max_ptrs; n++) {
-		if (!db->ptrs[n]) {
-			db->ptrs[n] = ptr;
-			return n;
-		}
-	}
+static void hash_insert(struct handle_db *db, uint32_t handle)
+{
+	uint32_t h = hash_ptr(db, db->ptrs[handle]);
+
+	db->hash_next[handle] = db->hash_head[h];
+	db->hash_head[h] = handle;
+}
+
+static void hash_remove(struct handle_db *db, uint32_t handle)
+{
+	uint32_t *p = db->hash_head + hash_ptr(db, db->ptrs[handle]);
+
+	while (*p && *p != handle)
+		p = db->hash_next + *p;
+	if (*p)
+		*p = db->hash_next[handle];
+}
+
+static bool grow_db(struct handle_db *db)
+{
+	uint32_t new_max_ptrs = 0;
+	uint32_t *hash_head = NULL;
+	uint32_t *hash_next = NULL;
+	uint32_t n = 0;
+	void *p = NULL;
 
-	/* No location available, grow the ptrs array */
 	if (db->max_ptrs)
 		new_max_ptrs = db->max_ptrs * 2;
 	else
 		new_max_ptrs = HANDLE_DB_INITIAL_MAX_PTRS;
+	if (new_max_ptrs < db->max_ptrs)
+		return false;
 
 	p = TEE_Realloc(db->ptrs, new_max_ptrs * sizeof(void *));
 	if (!p)
-		return 0;
+		return false;
 	db->ptrs = p;
 	TEE_MemFill(db->ptrs + db->max_ptrs, 0,
 		    (new_max_ptrs - db->max_ptrs) * sizeof(void *));
+
+	/*
+	 * If something fails below the ptrs array above is just larger
+	 * than needed, max_ptrs is only updated once all arrays are large
+	 * enough.
+	 */
+	p = TEE_Realloc(db->free_idx, new_max_ptrs * sizeof(uint32_t));
+	if (!p)
+		return false;
+	db->free_idx = p;
+
+	hash_head = TEE_Malloc(new_max_ptrs * sizeof(uint32_t),
+			       TEE_MALLOC_FILL_ZERO);
+	hash_next = TEE_Malloc(new_max_ptrs * sizeof(uint32_t),
+			       TEE_MALLOC_FILL_ZERO);
+	if (!hash_head || !hash_next) {
+		TEE_Free(hash_head);
+		TEE_Free(hash_next);
+		return false;
+	}
+	TEE_Free(db->hash_head);
+	TEE_Free(db->hash_next);
+	db->hash_head = hash_head;
+	db->hash_next = hash_next;
+
+	/*
+	 * Push the new handles so that the lowest is popped first, index
+	 * 0 is reserved as invalid.
+	 */
+	for (n = new_max_ptrs; n > db->max_ptrs && n > 1; n--)
+		db->free_idx[db->num_free++] = n - 1;
 	db->max_ptrs = new_max_ptrs;
 
-	/* Since n stopped at db->max_ptrs there is an empty location there */
+	/* The number of buckets changed, rebuild the reverse map */
+	for (n = 1; n < db->max_ptrs; n++)
+		if (db->ptrs[n])
+			hash_insert(db, n);
+
+	return true;
+}
+
+uint32_t handle_get(struct handle_db *db, void *ptr)
+{
+	uint32_t n = 0;
+
+	if (!db || !ptr)
+		return 0;
+
+	/* If there's no empty location available, grow the database */
+	if (!db->num_free && !grow_db(db))
+		return 0;
+
+	db->num_free--;
+	n = db->free_idx[db->num_free];
 	db->ptrs[n] = ptr;
+	hash_insert(db, n);
 	return n;
 }
 
@@ -75,7 +148,12 @@ void *handle_put(struct handle_db *db, uint32_t handle)
 		return NULL;
 
 	p = db->ptrs[handle];
-	db->ptrs[handle] = NULL;
+	if (p) {
+		hash_remove(db, handle);
+		db->ptrs[handle] = NULL;
+		db->free_idx[db->num_free] = handle;
+		db->num_free++;
+	}
 	return p;
 }
 
@@ -91,8 +169,9 @@ uint32_t handle_lookup_handle(struct handle_db *db, void *ptr)
 {
 	uint32_t n = 0;
 
-	if (ptr) {
-		for (n = 1; n < db->max_ptrs; n++)
+	if (ptr && db->max_ptrs) {
+		for (n = db->hash_head[hash_ptr(db, ptr)]; n;
+		     n = db->hash_next[n])
 			if (db->ptrs[n] == ptr)
 				return n;
 	}
@@ -8,8 +8,22 @@
 
 #include <stddef.h>
 
+/*
+ * struct handle_db - handle database
+ * @ptrs:	pointers associated with the handles, NULL if unused
+ * @free_idx:	stack of unused handles, @max_ptrs entries allocated
+ * @num_free:	number of handles in @free_idx
+ * @hash_head:	reverse map from pointer to handle, @max_ptrs buckets each
+ *		holding the first handle of a chain, 0 terminates a chain
+ * @hash_next:	next handle in the chain, indexed by handle
+ * @max_ptrs:	number of allocated entries in @ptrs, a power of 2
+ */
 struct handle_db {
 	void **ptrs;
+	uint32_t *free_idx;
+	uint32_t num_free;
+	uint32_t *hash_head;
+	uint32_t *hash_next;
 	uint32_t max_ptrs;
 };
 